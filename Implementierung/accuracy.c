@@ -0,0 +1,214 @@
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "read.h"
+#include "benchmarking.h"
+#include "accuracy.h"
+#include "bufpool.h"
+
+/*
+ * Accuracy-vs-speed comparison (--compare).
+ *
+ * Every version runs on every image for every gamma value of the sweep and its output is compared with the output of
+ * gamma_V0 (powf from math.h) for the same input. Per version and gamma the maximum absolute error, the PSNR over all
+ * pixels, the distribution of the absolute error, the error per reference gray level and the kernel time are reported,
+ * so the fastest version that still meets an error budget can be chosen.
+ */
+
+// Parses a comma separated list of non-negative floats, returns the number of values or 0 if the list is invalid
+size_t parse_gammas(const char* list, float* gammas, size_t max){
+    size_t count = 0;
+    const char* p = list;
+    while (*p) {
+        char* end;
+        float value = strtof(p, &end);
+        if (end == p || value < 0 || count == max || (*end != ',' && *end != '\0')) {
+            return 0;
+        }
+        gammas[count++] = value;
+        p = *end == ',' ? end + 1 : end;
+    }
+    return count;
+}
+
+static double psnr(const struct accuracy_stats* s){
+    if (s->pixels == 0 || s->squared_error == 0) {
+        return INFINITY;
+    }
+    double mse = s->squared_error / s->pixels;
+    return 10.0 * log10(255.0 * 255.0 / mse);
+}
+
+static void accumulate(struct accuracy_stats* s, const uint8_t* reference, const uint8_t* output, size_t pixels){
+    for (size_t i = 0; i < pixels; i++) {
+        int error = abs((int)output[i] - (int)reference[i]);
+        uint8_t level = reference[i];
+        s->error_count[error]++;
+        s->level_pixels[level]++;
+        s->level_error_sum[level] += (uint64_t)error;
+        if (error > s->level_max_error[level]) {
+            s->level_max_error[level] = (uint8_t)error;
+        }
+        if (error > s->max_error) {
+            s->max_error = error;
+        }
+        s->squared_error += (double)error * error;
+    }
+    s->pixels += pixels;
+}
+
+static void print_accuracy(FILE* file, const struct accuracy_stats* stats, size_t count){
+    fprintf(file, "%-8s %7s %9s %9s %10s %10s %12s %s\n", "version", "gamma", "max err", "PSNR dB", "exact %", "time ms", "MP/s", "worst levels (reference gray: max err)");
+    for (size_t i = 0; i < count; i++) {
+        const struct accuracy_stats* s = &stats[i];
+
+        // The three gray levels with the largest error show where an approximation breaks down
+        int worst[3] = {-1, -1, -1};
+        for (int level = 0; level < 256; level++) {
+            if (s->level_pixels[level] == 0 || s->level_max_error[level] == 0) {
+                continue;
+            }
+            for (int k = 0; k < 3; k++) {
+                if (worst[k] < 0 || s->level_max_error[level] > s->level_max_error[worst[k]]) {
+                    for (int m = 2; m > k; m--) {
+                        worst[m] = worst[m - 1];
+                    }
+                    worst[k] = level;
+                    break;
+                }
+            }
+        }
+
+        fprintf(file, "V%-7d %7.3f %9d %9.2f %10.3f %10.3f %12.2f", s->version, s->gamma, s->max_error, psnr(s),
+                s->pixels ? 100.0 * s->error_count[0] / s->pixels : 0.0, s->seconds * 1e3,
+                s->seconds > 0 ? s->pixels / s->seconds / 1e6 : 0.0);
+        for (int k = 0; k < 3 && worst[k] >= 0; k++) {
+            fprintf(file, " %d:%d", worst[k], s->level_max_error[worst[k]]);
+        }
+        fprintf(file, "\n");
+    }
+}
+
+static void write_accuracy_json(const char* path, const struct accuracy_stats* stats, size_t count){
+    FILE* file = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+    if (!file) {
+        perror("Error opening report file");
+        exit(EXIT_FAILURE);
+    }
+    fprintf(file, "{\n  \"reference\": 0,\n  \"results\": [\n");
+    for (size_t i = 0; i < count; i++) {
+        const struct accuracy_stats* s = &stats[i];
+        double p = psnr(s);
+        fprintf(file, "    {\"version\": %d, \"gamma\": %g, \"pixels\": %llu, \"max_abs_error\": %d, ", s->version, s->gamma,
+                (unsigned long long)s->pixels, s->max_error);
+        if (isinf(p)) {
+            fprintf(file, "\"psnr_db\": null, ");       // identical output
+        } else {
+            fprintf(file, "\"psnr_db\": %.3f, ", p);
+        }
+        fprintf(file, "\"seconds\": %.9f,\n     \"error_histogram\": [", s->seconds);
+        for (int e = 0; e < 256; e++) {
+            fprintf(file, "%s%llu", e ? ", " : "", (unsigned long long)s->error_count[e]);
+        }
+        fprintf(file, "],\n     \"max_error_per_level\": [");
+        for (int level = 0; level < 256; level++) {
+            fprintf(file, "%s%d", level ? ", " : "", s->level_max_error[level]);
+        }
+        fprintf(file, "],\n     \"mean_error_per_level\": [");
+        for (int level = 0; level < 256; level++) {
+            double mean = s->level_pixels[level] ? (double)s->level_error_sum[level] / s->level_pixels[level] : 0.0;
+            fprintf(file, "%s%.4f", level ? ", " : "", mean);
+        }
+        fprintf(file, "]}%s\n", i + 1 < count ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    if (file != stdout) {
+        fclose(file);
+    }
+}
+
+/*
+ * Compares every version with gamma_V0 over all images and gamma values.
+ *
+ * Parameters:
+ *  - char** files, size_t count: The P6 images of the corpus.
+ *  - const float* gammas, size_t gamma_count: The gamma values of the sweep.
+ *  - float a, b, c: Coefficients for the grayscale conversion.
+ *  - const struct point_pipeline* ops: The --ops operations, applied by the reference as well.
+ *  - thread_pool* pool: Pool for running the kernels, may be NULL.
+ *  - FILE* info: Stream for the summary table.
+ *  - const char* json: File for the full report including the histograms, NULL for none.
+ */
+void run_accuracy(char** files, size_t count, const float* gammas, size_t gamma_count, float a, float b, float c, const struct point_pipeline* ops, thread_pool* pool, FILE* info, const char* json){
+    size_t versions = NUM_VERSIONS - 1;           // every version except the reference
+    size_t rows = gamma_count * versions;
+    struct accuracy_stats* stats = calloc(rows, sizeof(struct accuracy_stats));
+    struct kernel_plan* plans = malloc(NUM_VERSIONS * sizeof(struct kernel_plan));      // plans[0] is the reference
+    if (!stats || !plans) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int v = 0; v < NUM_VERSIONS; v++) {
+        plan_init(&plans[v], a, b, c, gammas[0], 255, 0, ops);
+        plan_kernel(&plans[v], v);
+    }
+    for (size_t v = 0; v < versions; v++) {
+        for (size_t g = 0; g < gamma_count; g++) {
+            stats[v * gamma_count + g].version = (int)v + 1;
+            stats[v * gamma_count + g].gamma = gammas[g];
+        }
+    }
+
+    size_t compared = 0;
+    for (size_t f = 0; f < count; f++) {
+        PPMImage image;
+        if (try_read_p6(files[f], &image, "by --compare") != GAMMA_OK) {
+            continue;                                      //reported, the other images are still compared
+        }
+        compared++;
+        size_t pixels = image.width * image.height;
+        uint8_t* reference = bufpool_get(pixels);          //recycled from the previous image if it fits
+        uint8_t* output = bufpool_get(pixels);
+        if (!reference || !output) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+
+        for (size_t g = 0; g < gamma_count; g++) {
+            for (int v = 0; v < NUM_VERSIONS; v++) {
+                plan_set_gamma(&plans[v], gammas[g]);          //outside of the timed runs
+            }
+            threadpool_run(pool, &plans[0], image.image, image.width, image.height, image.stride, reference, image.width);
+
+            for (size_t v = 0; v < versions; v++) {
+                struct accuracy_stats* s = &stats[v * gamma_count + g];
+                struct timespec start, end;
+
+                clock_gettime(CLOCK_MONOTONIC, &start);
+                threadpool_run(pool, &plans[s->version], image.image, image.width, image.height, image.stride, output, image.width);
+                clock_gettime(CLOCK_MONOTONIC, &end);
+                s->seconds += (end.tv_sec - start.tv_sec) + 1e-9 * (end.tv_nsec - start.tv_nsec);
+
+                accumulate(s, reference, output, pixels);
+            }
+        }
+        bufpool_put(reference);
+        bufpool_put(output);
+        free_p6(&image);
+    }
+
+    fprintf(info, "Compared with version 0 over %zu images and %zu gamma values: \n", compared, gamma_count);
+    print_accuracy(info, stats, rows);
+    if (json) {
+        write_accuracy_json(json, stats, rows);
+    }
+    for (int v = 0; v < NUM_VERSIONS; v++) {
+        plan_free(&plans[v]);
+    }
+    free(plans);
+    free(stats);
+}
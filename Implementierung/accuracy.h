@@ -0,0 +1,29 @@
+#ifndef ACCURACY_H
+#define ACCURACY_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "kernels.h"
+
+// Maximum number of gamma values of --gammas
+#define MAX_GAMMAS 32
+
+// Deviation of one version from the gamma_V0 reference for one gamma value, accumulated over all images
+struct accuracy_stats {
+    int version;
+    float gamma;
+    uint64_t pixels;
+    int max_error;
+    double squared_error;            // sum of squared differences
+    double seconds;                  // time spent in the kernel
+    uint64_t error_count[256];       // number of pixels per absolute error
+    uint8_t level_max_error[256];    // largest absolute error per reference gray level
+    uint64_t level_pixels[256];      // reference pixels per gray level
+    uint64_t level_error_sum[256];   // sum of absolute errors per reference gray level
+};
+
+size_t parse_gammas(const char* list, float* gammas, size_t max);
+void run_accuracy(char** files, size_t count, const float* gammas, size_t gamma_count, float a, float b, float c, const struct point_pipeline* ops, thread_pool* pool, FILE* info, const char* json);
+
+#endif  // ACCURACY_H
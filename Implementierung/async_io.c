@@ -0,0 +1,295 @@
+#define _GNU_SOURCE
+#include <aio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include "read.h"
+#include "write.h"
+#include "ingest.h"
+#include "async_io.h"
+
+/*
+ * Asynchronous strip engine.
+ *
+ * Like the streaming mode (stream.c) the image is processed in strips of rows, but reads and writes are submitted
+ * asynchronously: while strip s is processed, the reads of the following strips and the write of the previous ones
+ * are already in flight, so the run takes about max(I/O, compute) instead of their sum. Each of the ASYNC_BUFFERS
+ * slots owns one page-aligned input and one output buffer.
+ *
+ * Requests go through io_uring (used with the raw system calls, no liburing needed). If the kernel doesn't offer
+ * io_uring, e.g. because it is disabled, POSIX AIO is used instead with the same slot logic.
+ */
+
+#define SLOTS (2 * ASYNC_BUFFERS)            // slots 0..ASYNC_BUFFERS-1 read, the others write
+
+struct async_io {
+    int uring;                              // 1 if io_uring is used, 0 for POSIX AIO
+    // io_uring
+    int ring_fd;
+    void* sq_ring;
+    void* cq_ring;
+    size_t sq_ring_size;
+    size_t cq_ring_size;
+    struct io_uring_sqe* sqes;
+    size_t sqes_size;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_cqe* cqes;
+    // POSIX AIO
+    struct aiocb cb[SLOTS];
+    // state of every slot
+    int pending[SLOTS];
+    ssize_t result[SLOTS];
+    size_t length[SLOTS];
+};
+
+static int uring_init(struct async_io* io){
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    io->ring_fd = (int)syscall(__NR_io_uring_setup, SLOTS, &params);
+    if(io->ring_fd < 0){
+        return 0;
+    }
+
+    io->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    io->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if(params.features & IORING_FEAT_SINGLE_MMAP){
+        if(io->cq_ring_size > io->sq_ring_size){
+            io->sq_ring_size = io->cq_ring_size;
+        }
+        io->cq_ring_size = io->sq_ring_size;
+    }
+    io->sq_ring = mmap(NULL, io->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, io->ring_fd, IORING_OFF_SQ_RING);
+    io->cq_ring = params.features & IORING_FEAT_SINGLE_MMAP ? io->sq_ring
+                : mmap(NULL, io->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, io->ring_fd, IORING_OFF_CQ_RING);
+    io->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    io->sqes = mmap(NULL, io->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, io->ring_fd, IORING_OFF_SQES);
+    if(io->sq_ring == MAP_FAILED || io->cq_ring == MAP_FAILED || io->sqes == MAP_FAILED){
+        close(io->ring_fd);
+        return 0;
+    }
+
+    uint8_t* sq = io->sq_ring;
+    uint8_t* cq = io->cq_ring;
+    io->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    io->sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+    io->sq_array = (unsigned*)(sq + params.sq_off.array);
+    io->cq_head = (unsigned*)(cq + params.cq_off.head);
+    io->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    io->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+    io->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+    return 1;
+}
+
+static void async_init(struct async_io* io){
+    memset(io, 0, sizeof(*io));
+    io->uring = uring_init(io);
+}
+
+static void async_destroy(struct async_io* io){
+    if(io->uring){
+        munmap(io->sqes, io->sqes_size);
+        if(io->cq_ring != io->sq_ring){
+            munmap(io->cq_ring, io->cq_ring_size);
+        }
+        munmap(io->sq_ring, io->sq_ring_size);
+        close(io->ring_fd);
+    }
+}
+
+// Starts a read (write = 0) or write of `length` bytes at `offset`, completion is awaited with async_wait(slot)
+static void async_submit(struct async_io* io, int slot, int write, int fd, void* buffer, size_t length, size_t offset){
+    io->pending[slot] = 1;
+    io->length[slot] = length;
+
+    if(io->uring){
+        unsigned tail = *io->sq_tail;
+        unsigned index = tail & *io->sq_mask;
+        struct io_uring_sqe* sqe = &io->sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+        sqe->fd = fd;
+        sqe->addr = (uint64_t)(uintptr_t)buffer;
+        sqe->len = (uint32_t)length;
+        sqe->off = offset;
+        sqe->user_data = (uint64_t)slot;
+        io->sq_array[index] = index;
+        __atomic_store_n(io->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+        if(syscall(__NR_io_uring_enter, io->ring_fd, 1, 0, 0, NULL, 0) < 0){
+            perror("Error submitting I/O");
+            exit(EXIT_FAILURE);
+        }
+    }else{
+        struct aiocb* cb = &io->cb[slot];
+        memset(cb, 0, sizeof(*cb));
+        cb->aio_fildes = fd;
+        cb->aio_buf = buffer;
+        cb->aio_nbytes = length;
+        cb->aio_offset = (off_t)offset;
+        if((write ? aio_write(cb) : aio_read(cb)) != 0){
+            perror("Error submitting I/O");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+// Blocks until the request of a slot is complete and returns the number of bytes transferred
+static size_t async_wait(struct async_io* io, int slot){
+    if(!io->pending[slot]){
+        return 0;
+    }
+
+    if(io->uring){
+        // Completions arrive in any order, remember those of other slots
+        while(io->pending[slot]){
+            unsigned head = *io->cq_head;
+            if(head == __atomic_load_n(io->cq_tail, __ATOMIC_ACQUIRE)){
+                if(syscall(__NR_io_uring_enter, io->ring_fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno != EINTR){
+                    perror("Error waiting for I/O");
+                    exit(EXIT_FAILURE);
+                }
+                continue;
+            }
+            struct io_uring_cqe* cqe = &io->cqes[head & *io->cq_mask];
+            int done = (int)cqe->user_data;
+            io->result[done] = cqe->res < 0 ? -1 : cqe->res;
+            errno = cqe->res < 0 ? -cqe->res : 0;
+            io->pending[done] = 0;
+            __atomic_store_n(io->cq_head, head + 1, __ATOMIC_RELEASE);
+        }
+    }else{
+        struct aiocb* cb = &io->cb[slot];
+        const struct aiocb* list[1] = {cb};
+        int error;
+        while((error = aio_error(cb)) == EINPROGRESS){
+            aio_suspend(list, 1, NULL);
+        }
+        io->result[slot] = aio_return(cb);
+        errno = error;
+        io->pending[slot] = 0;
+    }
+
+    if(io->result[slot] < 0 || (size_t)io->result[slot] != io->length[slot]){
+        fprintf(stderr, "Error in asynchronous I/O: %s\n", io->result[slot] < 0 ? strerror(errno) : "short transfer");
+        exit(EXIT_FAILURE);
+    }
+    return (size_t)io->result[slot];
+}
+
+static uint8_t* alloc_buffer(size_t size){
+    size_t page = 4096;
+    uint8_t* buffer = aligned_alloc(page, (size + page - 1) / page * page);
+    if(!buffer){
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    return buffer;
+}
+
+/*
+ * Converts a P6 file to a P5 file with asynchronous, triple-buffered strip I/O.
+ *
+ * Parameters:
+ *  - const char* input: Name of the P6 file (must be a regular file, reads are issued at explicit offsets).
+ *  - const char* output: Output name without extension, ".pgm" is appended.
+ *  - size_t rows: Number of rows per strip.
+ *  - const struct kernel_plan* plan: The kernel to run on every strip with its parameters and tables.
+ *  - thread_pool* pool: Pool that processes each strip in row bands, may be NULL.
+ *  - const char** backend: Receives the name of the I/O interface that was used.
+ *
+ * Returns:
+ *  - double: The time in seconds from opening the input until the last write completed.
+ */
+double async_p6_to_p5(const char* input, const char* output, size_t rows, const struct kernel_plan* plan, thread_pool* pool, const char** backend){
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    P6Ingest in;
+    ingest_open(input, &in);
+    size_t width = in.width;
+    size_t height = in.height;
+
+    char filename[strlen(output) + 5];
+    p5_filename(output, filename);
+    int out = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(out < 0){
+        perror("Error opening file");
+        exit(EXIT_FAILURE);
+    }
+    char header[64];
+    size_t header_length = (size_t)format_p5_header(header, sizeof(header), width, height);
+    if(pwrite(out, header, header_length, 0) != (ssize_t)header_length){
+        perror("Error writing file");
+        exit(EXIT_FAILURE);
+    }
+
+    if(rows == 0 || rows > height){
+        rows = height;
+    }
+    size_t strips = (height + rows - 1) / rows;
+    uint8_t* strip_in[ASYNC_BUFFERS];
+    uint8_t* strip_out[ASYNC_BUFFERS];
+    for(int i = 0; i < ASYNC_BUFFERS; i++){
+        strip_in[i] = alloc_buffer(width * rows * 3);
+        strip_out[i] = alloc_buffer(width * rows);
+    }
+
+    struct async_io io;
+    async_init(&io);
+    *backend = io.uring ? "io_uring" : "POSIX AIO";
+
+    // Rows of strip s start at s * rows; the last strip may be shorter
+    #define STRIP_ROWS(s) (height - (s) * rows < rows ? height - (s) * rows : rows)
+
+    for(size_t s = 0; s < strips && s < ASYNC_BUFFERS; s++){
+        async_submit(&io, (int)s, 0, in.fd, strip_in[s], width * STRIP_ROWS(s) * 3, in.offset + s * rows * width * 3);
+    }
+
+    for(size_t s = 0; s < strips; s++){
+        int slot = (int)(s % ASYNC_BUFFERS);
+        size_t count = STRIP_ROWS(s);
+
+        async_wait(&io, slot);                       // input of this strip
+        async_wait(&io, ASYNC_BUFFERS + slot);       // output buffer is free again once strip s - ASYNC_BUFFERS is written
+        if(!check_max_val(strip_in[slot], width * count * 3, in.max_val)){
+            fprintf(stderr, "Error: Pixel value exceeds the maximum value of %d\n", in.max_val);
+            exit(EXIT_FAILURE);
+        }
+
+        threadpool_run(pool, plan, strip_in[slot], width, count, width * 3, strip_out[slot], width);
+
+        async_submit(&io, ASYNC_BUFFERS + slot, 1, out, strip_out[slot], width * count, header_length + s * rows * width);
+        size_t next = s + ASYNC_BUFFERS;
+        if(next < strips){
+            async_submit(&io, slot, 0, in.fd, strip_in[slot], width * STRIP_ROWS(next) * 3, in.offset + next * rows * width * 3);
+        }
+    }
+    for(int slot = 0; slot < ASYNC_BUFFERS; slot++){
+        async_wait(&io, ASYNC_BUFFERS + slot);
+    }
+    #undef STRIP_ROWS
+
+    async_destroy(&io);
+    for(int i = 0; i < ASYNC_BUFFERS; i++){
+        free(strip_in[i]);
+        free(strip_out[i]);
+    }
+    close(in.fd);
+    close(out);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start.tv_sec) + 1e-9 * (end.tv_nsec - start.tv_nsec);
+}
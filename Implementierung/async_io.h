@@ -0,0 +1,14 @@
+#ifndef ASYNC_IO_H
+#define ASYNC_IO_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "kernels.h"
+#include "threadpool.h"
+
+// Strips in flight: one being processed, the others being read or written
+#define ASYNC_BUFFERS 3
+
+double async_p6_to_p5(const char* input, const char* output, size_t rows, const struct kernel_plan* plan, thread_pool* pool, const char** backend);
+
+#endif  // ASYNC_IO_H
@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "gamma_V2.h"
+#include "gamma_V5.h"
+#include "pipeline.h"
+#include "autogamma.h"
+
+// State of one autoGamma() call shared by the bands of both passes
+struct auto_job {
+    const uint8_t* img;
+    size_t width;
+    size_t height;
+    size_t stride;
+    float a, b, c;
+    uint8_t* result;
+    size_t result_stride;
+    size_t bands;
+    uint32_t (*histograms)[256];       // one histogram per band, added up after the first pass
+    uint8_t table[256];
+};
+
+static void gray_band(void* ctx, size_t index){
+    struct auto_job* job = ctx;
+    size_t first = job->height * index / job->bands;
+    size_t last = job->height * (index + 1) / job->bands;
+    convertToGrayscaleHistogram(job->img + first * job->stride, job->width, last - first, job->stride, job->a, job->b, job->c,
+                                job->result + first * job->result_stride, job->result_stride, job->histograms[index]);
+}
+
+static void table_band(void* ctx, size_t index){
+    struct auto_job* job = ctx;
+    size_t first = job->height * index / job->bands;
+    size_t last = job->height * (index + 1) / job->bands;
+    pipeline_apply(job->table, job->result + first * job->result_stride, job->width, last - first, job->result_stride);
+}
+
+// Smallest gray value with at least half of the pixels at or below it
+int histogramMedian(const uint32_t* histogram){
+    uint64_t pixels = 0;
+    for (int v = 0; v < 256; v++) {
+        pixels += histogram[v];
+    }
+    uint64_t sum = 0;
+    for (int v = 0; v < 256; v++) {
+        sum += histogram[v];
+        if (sum * 2 >= pixels) {
+            return v;
+        }
+    }
+    return 255;
+}
+
+// Gamma that maps the median gray value to mid gray: (median / 255)^gamma = 0.5, limited to [AUTO_GAMMA_MIN, AUTO_GAMMA_MAX]
+float gammaFromHistogram(const uint32_t* histogram){
+    float median = ((float)histogramMedian(histogram) + 0.5f) / 255.0f;     // centre of the gray level
+    if (median > 254.5f / 255.0f) {
+        median = 254.5f / 255.0f;
+    }
+    float gamma = logf(0.5f) / logf(median);
+    return fminf(fmaxf(gamma, AUTO_GAMMA_MIN), AUTO_GAMMA_MAX);
+}
+
+/*
+ * Gamma correction with a gamma derived from the image (--gamma auto).
+ *
+ * Parameters:
+ *  - thread_pool* pool: Threads processing one band of rows each, may be NULL.
+ *  - const uint8_t* img, size_t width, size_t height, size_t stride: The RGB image.
+ *  - float a, b, c: Coefficients of the grayscale conversion.
+ *  - const struct point_pipeline* ops: The --ops operations, fused into the table of the second pass.
+ *  - uint8_t* result, size_t result_stride: Receives the corrected gray image.
+ *  - int* median: Receives the median gray value, may be NULL.
+ *
+ * Returns:
+ *  - float: The gamma that was applied.
+ *
+ * Description:
+ * The first pass converts the image to gray into the result buffer and builds the luminance histogram at the same time
+ * (convertToGrayscaleHistogram, one histogram per band). The gamma is chosen so that the median maps to mid gray. The
+ * second pass maps the gray buffer in place through the gamma table of gamma_V5 together with the --ops operations,
+ * so the RGB input is read only once.
+ */
+float autoGamma(thread_pool* pool, const uint8_t* img, size_t width, size_t height, size_t stride, float a, float b, float c, const struct point_pipeline* ops, uint8_t* result, size_t result_stride, int* median){
+    struct auto_job job = {img, width, height, stride, a, b, c, result, result_stride, threadpool_size(pool), NULL, {0}};
+    if (job.bands > height) {
+        job.bands = height > 0 ? height : 1;
+    }
+    uint32_t single[1][256];
+    job.histograms = calloc(job.bands, sizeof(*job.histograms));
+    if (!job.histograms) {
+        memset(single, 0, sizeof(single));          // one band on the calling thread
+        job.histograms = single;
+        job.bands = 1;
+    }
+    threadpool_for(pool, gray_band, &job, job.bands);
+
+    uint32_t histogram[256] = {0};
+    for (size_t band = 0; band < job.bands; band++) {
+        for (size_t v = 0; v < 256; v++) {
+            histogram[v] += job.histograms[band][v];
+        }
+    }
+    if (job.histograms != single) {
+        free(job.histograms);
+    }
+    if (median) {
+        *median = histogramMedian(histogram);
+    }
+
+    float gamma = gammaFromHistogram(histogram);
+    buildGammaTable(gamma, 1, job.table);
+    pipeline_fuse(ops, job.table);
+    threadpool_for(pool, table_band, &job, job.bands);
+    return gamma;
+}
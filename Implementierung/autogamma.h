@@ -0,0 +1,17 @@
+#ifndef AUTOGAMMA_H
+#define AUTOGAMMA_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "threadpool.h"
+#include "pipeline.h"
+
+// Range of the gamma values --gamma auto may choose
+#define AUTO_GAMMA_MIN 0.1f
+#define AUTO_GAMMA_MAX 10.0f
+
+int histogramMedian(const uint32_t* histogram);
+float gammaFromHistogram(const uint32_t* histogram);
+float autoGamma(thread_pool* pool, const uint8_t* img, size_t width, size_t height, size_t stride, float a, float b, float c, const struct point_pipeline* ops, uint8_t* result, size_t result_stride, int* median);
+
+#endif  // AUTOGAMMA_H
@@ -0,0 +1,453 @@
+#define _DEFAULT_SOURCE
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include "read.h"
+#include "write.h"
+#include "batch.h"
+#include "bufpool.h"
+
+/*
+ * Batch mode: many images in one process.
+ *
+ * The images travel through three stages connected by bounded queues:
+ *   reader threads  -> try_read_p6() the next file of the list
+ *   compute workers -> run the selected kernel on one whole image each
+ *   writer threads  -> try_write_p5() the result and release both buffers
+ * The result buffers (and the inputs that can't be mapped) come from bufpool_get(), so once as many images as can be
+ * in flight have passed, the batch runs without allocating.
+ * While one image is being computed, the next ones are already read and the previous ones written. The queues are
+ * bounded, so at most BATCH_QUEUE_DEPTH images wait between two stages no matter how long the list is.
+ * A file that can't be read, processed or written is reported and skipped, the batch goes on with the next one.
+ */
+
+// Bounded blocking FIFO of pointers
+struct queue {
+    void* items[BATCH_QUEUE_DEPTH];
+    size_t head;
+    size_t count;
+    unsigned producers;          // the queue is closed when the last producer is done
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+};
+
+static void queue_init(struct queue* q, unsigned producers){
+    q->head = 0;
+    q->count = 0;
+    q->producers = producers;
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->not_empty, NULL);
+    pthread_cond_init(&q->not_full, NULL);
+}
+
+static void queue_destroy(struct queue* q){
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy(&q->not_empty);
+    pthread_cond_destroy(&q->not_full);
+}
+
+static void queue_push(struct queue* q, void* item){
+    pthread_mutex_lock(&q->lock);
+    while(q->count == BATCH_QUEUE_DEPTH){
+        pthread_cond_wait(&q->not_full, &q->lock);
+    }
+    q->items[(q->head + q->count) % BATCH_QUEUE_DEPTH] = item;
+    q->count++;
+    pthread_cond_signal(&q->not_empty);
+    pthread_mutex_unlock(&q->lock);
+}
+
+// Returns the oldest item or NULL once the queue is empty and all producers are done
+static void* queue_pop(struct queue* q){
+    pthread_mutex_lock(&q->lock);
+    while(q->count == 0 && q->producers > 0){
+        pthread_cond_wait(&q->not_empty, &q->lock);
+    }
+    void* item = NULL;
+    if(q->count > 0){
+        item = q->items[q->head];
+        q->head = (q->head + 1) % BATCH_QUEUE_DEPTH;
+        q->count--;
+        pthread_cond_signal(&q->not_full);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return item;
+}
+
+static void queue_producer_done(struct queue* q){
+    pthread_mutex_lock(&q->lock);
+    if(--q->producers == 0){
+        pthread_cond_broadcast(&q->not_empty);
+    }
+    pthread_mutex_unlock(&q->lock);
+}
+
+struct batch_item {
+    size_t index;
+    PPMImage image;
+    uint8_t* result;
+};
+
+struct batch {
+    char** files;
+    size_t count;
+    size_t next;                 // next file for a reader, protected by lock
+    const char* output_dir;
+    const struct kernel_plan* plan;
+    struct queue to_compute;
+    struct queue to_write;
+    pthread_mutex_t lock;
+    size_t images;               // written results, protected by lock
+    size_t failed;               // skipped files, protected by lock
+    double megapixels;
+};
+
+static void count_failure(struct batch* batch){
+    pthread_mutex_lock(&batch->lock);
+    batch->failed++;
+    pthread_mutex_unlock(&batch->lock);
+}
+
+// The part of an input name the output is named after: without directory and .ppm extension
+static const char* output_stem(const char* input, size_t* length){
+    const char* name = strrchr(input, '/') ? strrchr(input, '/') + 1 : input;
+    *length = strlen(name);
+    if(*length > 4 && strcmp(name + *length - 4, ".ppm") == 0){
+        *length -= 4;
+    }
+    return name;
+}
+
+static void* reader_main(void* arg){
+    struct batch* batch = arg;
+    while(1){
+        pthread_mutex_lock(&batch->lock);
+        size_t index = batch->next++;
+        pthread_mutex_unlock(&batch->lock);
+        if(index >= batch->count){
+            break;
+        }
+
+        struct batch_item* item = malloc(sizeof(struct batch_item));
+        if(!item){
+            fprintf(stderr, "Skipping %s: Memory allocation failed\n", batch->files[index]);
+            count_failure(batch);
+            continue;
+        }
+        item->index = index;
+        if(try_read_p6(batch->files[index], &item->image, "in batch mode") != GAMMA_OK){
+            free(item);
+            count_failure(batch);
+            continue;
+        }
+        queue_push(&batch->to_compute, item);
+    }
+    queue_producer_done(&batch->to_compute);
+    return NULL;
+}
+
+static void* worker_main(void* arg){
+    struct batch* batch = arg;
+    struct batch_item* item;
+    while((item = queue_pop(&batch->to_compute))){
+        size_t width = item->image.width;
+        size_t height = item->image.height;
+        item->result = bufpool_get(width * height);          // a result written earlier in the batch if it fits
+        if(!item->result){
+            fprintf(stderr, "Skipping %s: Memory allocation failed\n", batch->files[item->index]);
+            free_p6(&item->image);
+            free(item);
+            count_failure(batch);
+            continue;
+        }
+        plan_run(batch->plan, item->image.image, width, height, item->image.stride, item->result, width);
+        free_p6(&item->image);      // the input isn't needed by the writer
+        item->image.width = width;
+        item->image.height = height;
+        queue_push(&batch->to_write, item);
+    }
+    queue_producer_done(&batch->to_write);
+    return NULL;
+}
+
+static void* writer_main(void* arg){
+    struct batch* batch = arg;
+    struct batch_item* item;
+    while((item = queue_pop(&batch->to_write))){
+        // <output_dir>/<input name without directory and .ppm extension>.pgm
+        size_t length;
+        const char* name = output_stem(batch->files[item->index], &length);
+        char output[strlen(batch->output_dir) + length + 2];
+        snprintf(output, sizeof(output), "%s/%.*s", batch->output_dir, (int)length, name);
+
+        int written = try_write_p5(output, item->result, item->image.width, item->image.height, item->image.width);
+
+        pthread_mutex_lock(&batch->lock);
+        if(written){
+            batch->images++;
+            batch->megapixels += (double)item->image.width * item->image.height / 1e6;
+        }else{
+            batch->failed++;
+        }
+        pthread_mutex_unlock(&batch->lock);
+        bufpool_put(item->result);
+        free(item);
+    }
+    return NULL;
+}
+
+// Lets the consumers of q finish for producers that will never run
+static void close_queue(struct queue* q, unsigned producers){
+    for(unsigned i = 0; i < producers; i++){
+        queue_producer_done(q);
+    }
+}
+
+/*
+ * Starts up to count threads of one stage and returns how many are running; they occupy the first entries of threads.
+ * Every thread that can't be started is reported and closes its share of output (NULL for the last stage), so the
+ * next stage still sees the end of the batch.
+ */
+static unsigned start_threads(pthread_t* threads, unsigned count, void* (*routine)(void*), struct batch* batch, struct queue* output){
+    unsigned started = 0;
+    for(unsigned i = 0; i < count; i++){
+        int error = pthread_create(&threads[started], NULL, routine, batch);
+        if(error != 0){
+            fprintf(stderr, "Error starting batch thread: %s\n", strerror(error));
+            if(output){
+                queue_producer_done(output);
+            }
+            continue;
+        }
+        started++;
+    }
+    return started;
+}
+
+static int compare_names(const void* x, const void* y){
+    return strcmp(*(char* const*)x, *(char* const*)y);
+}
+
+// Appends a copy of name to the list; without memory the file is reported and left out
+static void add_input(char*** files, size_t* count, size_t* capacity, const char* name){
+    if(*count == *capacity){
+        size_t grown = *capacity ? *capacity * 2 : 16;
+        char** larger = realloc(*files, grown * sizeof(char*));
+        if(!larger){
+            fprintf(stderr, "Skipping %s: Memory allocation failed\n", name);
+            return;
+        }
+        *files = larger;
+        *capacity = grown;
+    }
+    char* copy = strdup(name);
+    if(!copy){
+        fprintf(stderr, "Skipping %s: Memory allocation failed\n", name);
+        return;
+    }
+    (*files)[(*count)++] = copy;
+}
+
+/*
+ * Expands the positional arguments of batch mode into a list of files.
+ *
+ * Every argument is either a P6 file, a directory (all *.ppm files in it, sorted by name) or @<manifest>, a text file
+ * with one path per line (empty lines and lines starting with # are ignored). Returns the number of files; the list
+ * must be released with free_batch_inputs().
+ */
+size_t collect_batch_inputs(char** args, size_t count, char*** files){
+    size_t total = 0;
+    size_t capacity = 0;
+    *files = NULL;
+
+    for(size_t i = 0; i < count; i++){
+        const char* arg = args[i];
+        struct stat st;
+
+        if(arg[0] == '@'){
+            FILE* manifest = fopen(arg + 1, "r");
+            if(!manifest){
+                fprintf(stderr, "Skipping manifest %s: %s\n", arg + 1, strerror(errno));
+                continue;
+            }
+            char line[4096];
+            while(fgets(line, sizeof(line), manifest)){
+                line[strcspn(line, "\r\n")] = '\0';
+                if(line[0] != '\0' && line[0] != '#'){
+                    add_input(files, &total, &capacity, line);
+                }
+            }
+            fclose(manifest);
+        }else if(stat(arg, &st) == 0 && S_ISDIR(st.st_mode)){
+            DIR* dir = opendir(arg);
+            if(!dir){
+                fprintf(stderr, "Skipping directory %s: %s\n", arg, strerror(errno));
+                continue;
+            }
+            size_t first = total;
+            struct dirent* entry;
+            while((entry = readdir(dir))){
+                size_t length = strlen(entry->d_name);
+                if(length > 4 && strcmp(entry->d_name + length - 4, ".ppm") == 0){
+                    char path[strlen(arg) + length + 2];
+                    snprintf(path, sizeof(path), "%s/%s", arg, entry->d_name);
+                    add_input(files, &total, &capacity, path);
+                }
+            }
+            closedir(dir);
+            qsort(*files + first, total - first, sizeof(char*), compare_names);
+        }else{
+            add_input(files, &total, &capacity, arg);
+        }
+    }
+    return total;
+}
+
+struct output_name {
+    const char* stem;
+    size_t length;
+    size_t index;
+};
+
+// Orders by output name, equal names by their position in the list
+static int compare_outputs(const void* x, const void* y){
+    const struct output_name* a = x;
+    const struct output_name* b = y;
+    size_t length = a->length < b->length ? a->length : b->length;
+    int order = memcmp(a->stem, b->stem, length);
+    if(order == 0){
+        order = (a->length > b->length) - (a->length < b->length);
+    }
+    if(order == 0){
+        order = (a->index > b->index) - (a->index < b->index);
+    }
+    return order;
+}
+
+/*
+ * Checks that no two inputs are written to the same output file.
+ *
+ * The outputs are named after the input without its directory, so a/img.ppm and b/img.ppm would both become
+ * <output_dir>/img.pgm and the later one would overwrite the earlier one. Every such pair is reported (with the first
+ * input of the name) and the number of conflicting inputs is returned, 0 if all names are distinct.
+ */
+size_t check_batch_outputs(char** files, size_t count){
+    struct output_name* names = malloc(count * sizeof(struct output_name));
+    if(count > 0 && !names){
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    for(size_t i = 0; i < count; i++){
+        names[i].stem = output_stem(files[i], &names[i].length);
+        names[i].index = i;
+    }
+    qsort(names, count, sizeof(struct output_name), compare_outputs);
+
+    size_t conflicts = 0;
+    size_t first = 0;
+    for(size_t i = 1; i < count; i++){
+        if(names[i].length != names[first].length || memcmp(names[i].stem, names[first].stem, names[i].length) != 0){
+            first = i;
+            continue;
+        }
+        fprintf(stderr, "Error: %s and %s would both be written to %.*s.pgm\n", files[names[first].index], files[names[i].index],
+                (int)names[i].length, names[i].stem);
+        conflicts++;
+    }
+    free(names);
+    return conflicts;
+}
+
+void free_batch_inputs(char** files, size_t count){
+    for(size_t i = 0; i < count; i++){
+        free(files[i]);
+    }
+    free(files);
+}
+
+/*
+ * Processes a list of P6 files and writes "<output_dir>/<name>.pgm" for each of them.
+ *
+ * Parameters:
+ *  - char** files, size_t count: The input files.
+ *  - const char* output_dir: Directory for the results, created if it doesn't exist.
+ *  - const struct kernel_plan* plan: The kernel with its parameters and tables, shared by all workers.
+ *  - unsigned workers: Number of compute workers (each processes one image at a time).
+ *
+ * Returns:
+ *  - struct batch_stats: Number of images written and skipped, their total size and the wall-clock time of the whole
+ *    batch.
+ */
+struct batch_stats run_batch(char** files, size_t count, const char* output_dir, const struct kernel_plan* plan, unsigned workers){
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if(mkdir(output_dir, 0755) != 0 && errno != EEXIST){
+        perror("Error creating output directory");
+        exit(EXIT_FAILURE);
+    }
+    if(workers == 0){
+        workers = 1;
+    }
+
+    struct batch batch = {0};
+    batch.files = files;
+    batch.count = count;
+    batch.output_dir = output_dir;
+    batch.plan = plan;
+    pthread_mutex_init(&batch.lock, NULL);
+    queue_init(&batch.to_compute, BATCH_READERS);
+    queue_init(&batch.to_write, workers);
+
+    pthread_t readers[BATCH_READERS];
+    pthread_t writers[BATCH_WRITERS];
+    pthread_t* computes = malloc(workers * sizeof(pthread_t));
+    if(!computes){
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Consumers first: a stage only starts once something drains its output, so a failed start can't block it
+    unsigned started_writers = start_threads(writers, BATCH_WRITERS, writer_main, &batch, NULL);
+    unsigned started_workers = 0;
+    unsigned started_readers = 0;
+    if(started_writers > 0){
+        started_workers = start_threads(computes, workers, worker_main, &batch, &batch.to_write);
+    }else{
+        close_queue(&batch.to_write, workers);
+    }
+    if(started_workers > 0){
+        started_readers = start_threads(readers, BATCH_READERS, reader_main, &batch, &batch.to_compute);
+    }else{
+        close_queue(&batch.to_compute, BATCH_READERS);
+    }
+
+    for(unsigned i = 0; i < started_readers; i++){
+        pthread_join(readers[i], NULL);
+    }
+    for(unsigned i = 0; i < started_workers; i++){
+        pthread_join(computes[i], NULL);
+    }
+    for(unsigned i = 0; i < started_writers; i++){
+        pthread_join(writers[i], NULL);
+    }
+    if(batch.next < count){
+        batch.failed += count - batch.next;     // no reader got to these files
+    }
+
+    free(computes);
+    queue_destroy(&batch.to_compute);
+    queue_destroy(&batch.to_write);
+    pthread_mutex_destroy(&batch.lock);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    struct batch_stats stats = {batch.images, batch.failed, batch.megapixels, (end.tv_sec - start.tv_sec) + 1e-9 * (end.tv_nsec - start.tv_nsec)};
+    return stats;
+}
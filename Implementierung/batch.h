@@ -0,0 +1,26 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "kernels.h"
+
+// Threads reading and writing files in batch mode, the compute workers are given with -T
+#define BATCH_READERS 2
+#define BATCH_WRITERS 2
+// Images that may wait between two stages of the pipeline
+#define BATCH_QUEUE_DEPTH 4
+
+struct batch_stats {
+    size_t images;               // results written
+    size_t failed;               // inputs that were reported and skipped
+    double megapixels;
+    double seconds;
+};
+
+size_t collect_batch_inputs(char** args, size_t count, char*** files);
+size_t check_batch_outputs(char** files, size_t count);
+void free_batch_inputs(char** files, size_t count);
+struct batch_stats run_batch(char** files, size_t count, const char* output_dir, const struct kernel_plan* plan, unsigned workers);
+
+#endif  // BATCH_H
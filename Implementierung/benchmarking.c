@@ -1,12 +1,15 @@
 #define _POSIX_C_SOURCE 199309L
-#include "gamma_V0.h"
-#include "gamma_V1.h"
-#include "gamma_V2.h"
-#include "gamma_V3.h"
-#include "gamma_V4.h"
+#include "cpu_dispatch.h"
+#include "kernels.h"
+#include "threadpool.h"
+#include "perfcount.h"
 #include <time.h>
 #include "benchmarking.h"
+#include "libgamma.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
 
 // Helper function to prevent the compiler from optimizing away the loop
 
@@ -15,71 +18,140 @@ static void escape(void *p){
  
 }
 
-// Function to benchmark different gamma correction versions
-
-double benchmarking(uint32_t rep, int  version, const uint8_t* img, size_t width, size_t height, float a, float b, float c, float gamma, uint8_t* result){
- struct timespec start, end;
-    
-    
-   
-   
-    // Choose the appropriate gamma correction version based on the provided 'version' argument
-
-    switch (version) {
-        case 0:
-           clock_gettime(CLOCK_MONOTONIC, &start);
-            for (uint32_t j = 0; j < rep; j++) {
-                escape(result);   // Ensure enough runtime between time measurements
-                gamma_V0(img,width,height,a,b,c,gamma,result);
-                escape(result);
-            }
-            clock_gettime(CLOCK_MONOTONIC, &end);
-            break;
-        case 1:
-            clock_gettime(CLOCK_MONOTONIC, &start);
-            for (uint32_t j = 0; j < rep; j++) {
-                  escape(result);
-                gamma_V1(img,width,height,a,b,c,gamma,result);
-                escape(result);
-            }
-            clock_gettime(CLOCK_MONOTONIC, &end);
-            break;
-        case 2:
-            clock_gettime(CLOCK_MONOTONIC, &start);
-            for (uint32_t j = 0; j < rep; j++) {
-                 escape(result);
-                gamma_V2(img,width,height,a,b,c,gamma,result);
-                escape(result);
-            }
-            clock_gettime(CLOCK_MONOTONIC, &end);
-            break;
-        case 3:
-         clock_gettime(CLOCK_MONOTONIC, &start);
-            for (uint32_t j = 0; j < rep; j++) {
-                 escape(result);
-                gamma_V3(img,width,height,a,b,c,gamma,result);
-                escape(result);
-            }
-            clock_gettime(CLOCK_MONOTONIC, &end);
-            break;
-            case 4:
-            clock_gettime(CLOCK_MONOTONIC, &start);
-            for (uint32_t j = 0; j < rep; j++) {
-                  escape(result);
-                gamma_V4(img,width,height,a,b,c,gamma,result);
-                escape(result);
-            }
-            clock_gettime(CLOCK_MONOTONIC, &end);
-            break;
-             
-        default:
-            fprintf(stderr,"Invalid version\n");
-            free((void*)img);  // Free allocated memory before exiting in case of an invalid version
-            free((void*)img);
-free((void*)result);
-             
+static double elapsed(const struct timespec* start, const struct timespec* end){
+    return (end->tv_sec - start->tv_sec) + 1e-9 * (end->tv_nsec - start->tv_nsec);
+}
+
+// Function to benchmark the version of a libgamma context
+// After `warmup` untimed calls every one of the `rep` calls is timed on its own; samples (if not NULL) receives the rep times
+// and perf (if not NULL) the hardware counters of the timed loop
+
+double benchmarking(uint32_t rep, uint32_t warmup, gamma_context* context, const uint8_t* img, size_t width, size_t height, size_t stride, uint8_t* result, size_t result_stride, double* samples, struct perf_counters* perf){
+    struct timespec start, end, before, after;
+
+    // Warm up caches, page tables, the thread pool and the CPU clock before measuring
+    for (uint32_t j = 0; j < warmup; j++) {
+        escape(result);
+        gamma_process(context, img, width, height, stride, result, result_stride);
+        escape(result);
+    }
+
+    if (perf) {
+        perf_start(perf);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t j = 0; j < rep; j++) {
+        clock_gettime(CLOCK_MONOTONIC, &before);
+        escape(result);   // Ensure enough runtime between time measurements
+        gamma_process(context, img, width, height, stride, result, result_stride);   // the threads of the context are reused by every repetition
+        escape(result);
+        clock_gettime(CLOCK_MONOTONIC, &after);
+        if (samples) {
+            samples[j] = elapsed(&before, &after);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (perf) {
+        perf_stop(perf);
+    }
+
+    // Calculate and return the time taken for benchmarking
+    return elapsed(&start, &end);
+}
+
+static int compare_doubles(const void* x, const void* y){
+    double a = *(const double*)x;
+    double b = *(const double*)y;
+    return (a > b) - (a < b);
+}
+
+// Nearest-rank percentile of sorted samples
+static double percentile(const double* sorted, uint32_t count, double p){
+    size_t rank = (size_t)ceil(p * count);
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+// Summarises the per-iteration times of one version; pixels is the image size used for the throughput, pixel_bytes the
+// bytes read plus written per pixel (3 + 1 for 8 bit gray, 6 + 2 for 16 bit gray, 3 + 3 for color)
+void compute_stats(int version, const double* samples, uint32_t count, size_t pixels, size_t pixel_bytes, struct bench_stats* stats){
+    memset(stats, 0, sizeof(*stats));
+    stats->version = version;
+    stats->samples = count;
+    if (count == 0) {
+        return;
+    }
+
+    double* sorted = malloc(count * sizeof(double));
+    if (!sorted) {
+        fprintf(stderr, "Memory allocation failed\n");
         exit(EXIT_FAILURE);
     }
-      // Calculate and return the time taken for benchmarking
-    return (end.tv_sec - start.tv_sec) + 1e-9 * (end.tv_nsec - start.tv_nsec);
+    memcpy(sorted, samples, count * sizeof(double));
+    qsort(sorted, count, sizeof(double), compare_doubles);
+
+    double sum = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        sum += sorted[i];
+    }
+    stats->mean = sum / count;
+    double variance = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        variance += (sorted[i] - stats->mean) * (sorted[i] - stats->mean);
+    }
+    stats->stddev = count > 1 ? sqrt(variance / (count - 1)) : 0;     // sample standard deviation
+
+    stats->min = sorted[0];
+    stats->median = count % 2 ? sorted[count / 2] : (sorted[count / 2 - 1] + sorted[count / 2]) / 2;
+    stats->p95 = percentile(sorted, count, 0.95);
+    stats->p99 = percentile(sorted, count, 0.99);
+    if (stats->median > 0) {
+        stats->megapixels_per_s = pixels / stats->median / 1e6;
+        stats->bytes_per_s = (double)pixels * pixel_bytes / stats->median;
+    }
+    free(sorted);
+}
+
+// Prints one line per version, all times in milliseconds
+void print_stats(FILE* file, const struct bench_stats* stats, size_t count){
+    fprintf(file, "%-8s %8s %10s %10s %10s %10s %10s %10s %10s %10s\n", "version", "samples", "min ms", "median ms", "mean ms", "p95 ms", "p99 ms", "stddev ms", "MP/s", "MB/s");
+    for (size_t i = 0; i < count; i++) {
+        const struct bench_stats* s = &stats[i];
+        fprintf(file, "V%-7d %8u %10.4f %10.4f %10.4f %10.4f %10.4f %10.4f %10.2f %10.2f\n", s->version, s->samples,
+                s->min * 1e3, s->median * 1e3, s->mean * 1e3, s->p95 * 1e3, s->p99 * 1e3, s->stddev * 1e3,
+                s->megapixels_per_s, s->bytes_per_s / 1e6);
+    }
+}
+
+// Writes the statistics as JSON (csv = 0) or CSV, times in seconds; the path "-" stands for stdout
+void write_report(const char* path, int csv, const struct bench_stats* stats, size_t count, size_t width, size_t height, unsigned threads){
+    FILE* file = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+    if (!file) {
+        perror("Error opening report file");
+        exit(EXIT_FAILURE);
+    }
+
+    if (csv) {
+        fprintf(file, "version,width,height,threads,isa,samples,min_s,median_s,mean_s,p95_s,p99_s,stddev_s,megapixels_per_s,bytes_per_s\n");
+        for (size_t i = 0; i < count; i++) {
+            const struct bench_stats* s = &stats[i];
+            fprintf(file, "%d,%zu,%zu,%u,%s,%u,%.9f,%.9f,%.9f,%.9f,%.9f,%.9f,%.3f,%.0f\n", s->version, width, height, threads,
+                    cpu_isa_name(cpu_active_isa()), s->samples, s->min, s->median, s->mean, s->p95, s->p99, s->stddev,
+                    s->megapixels_per_s, s->bytes_per_s);
+        }
+    } else {
+        fprintf(file, "{\n  \"width\": %zu,\n  \"height\": %zu,\n  \"threads\": %u,\n  \"isa\": \"%s\",\n  \"results\": [\n",
+                width, height, threads, cpu_isa_name(cpu_active_isa()));
+        for (size_t i = 0; i < count; i++) {
+            const struct bench_stats* s = &stats[i];
+            fprintf(file, "    {\"version\": %d, \"samples\": %u, \"min_s\": %.9f, \"median_s\": %.9f, \"mean_s\": %.9f, "
+                          "\"p95_s\": %.9f, \"p99_s\": %.9f, \"stddev_s\": %.9f, \"megapixels_per_s\": %.3f, \"bytes_per_s\": %.0f}%s\n",
+                    s->version, s->samples, s->min, s->median, s->mean, s->p95, s->p99, s->stddev, s->megapixels_per_s,
+                    s->bytes_per_s, i + 1 < count ? "," : "");
+        }
+        fprintf(file, "  ]\n}\n");
+    }
+
+    if (file != stdout) {
+        fclose(file);
+    }
 }
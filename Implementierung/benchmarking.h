@@ -2,9 +2,33 @@
 #define BENCHMARK_H
 
 #include <stdint.h>
+#include <stdio.h>
 #include <time.h>
+#include "cpu_dispatch.h"
+#include "threadpool.h"
+#include "perfcount.h"
+#include "kernels.h"
+#include "libgamma.h"
+
+// Summary of the per-iteration samples of one benchmark run
+struct bench_stats {
+    int version;
+    uint32_t samples;
+    double min;
+    double median;
+    double mean;
+    double p95;
+    double p99;
+    double stddev;
+    double megapixels_per_s;      // based on the median iteration
+    double bytes_per_s;           // bytes read and written, based on the median iteration
+};
 
 // Define the function prototype for benchmarking
-double benchmarking(uint32_t rep, int version, const uint8_t *img, size_t width, size_t height, float a, float b, float c, float gamma, uint8_t *result);
+double benchmarking(uint32_t rep, uint32_t warmup, gamma_context* context, const uint8_t *img, size_t width, size_t height, size_t stride, uint8_t *result, size_t result_stride, double* samples, struct perf_counters* perf);
+
+void compute_stats(int version, const double* samples, uint32_t count, size_t pixels, size_t pixel_bytes, struct bench_stats* stats);
+void print_stats(FILE* file, const struct bench_stats* stats, size_t count);
+void write_report(const char* path, int csv, const struct bench_stats* stats, size_t count, size_t width, size_t height, unsigned threads);
 
 #endif // BENCHMARK_H
@@ -0,0 +1,187 @@
+#define _DEFAULT_SOURCE
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include "image.h"
+#include "bufpool.h"
+
+/*
+ * Recycling allocator for image and result buffers.
+ *
+ * Every buffer starts IMAGE_ALIGN bytes behind a header that records where it came from, so bufpool_put() needs no
+ * size. Released buffers are kept (up to BUFPOOL_MAX_CACHED of them and BUFPOOL_MAX_CACHED_BYTES in total) and handed
+ * out again for requests they fit; the pages of a recycled buffer are already mapped, so processing one image after
+ * another neither calls malloc nor takes page faults nor lets the kernel zero fresh pages. Buffers from
+ * BUFPOOL_HUGE_THRESHOLD on are mapped on their own: with MAP_HUGETLB if huge pages are reserved, otherwise aligned to
+ * a huge page and marked with MADV_HUGEPAGE so transparent huge pages back them. All functions are thread safe.
+ */
+
+// Upper bound of the bytes kept in released buffers, larger ones go back to the system
+#define BUFPOOL_MAX_CACHED_BYTES ((size_t)512 << 20)
+
+enum buffer_kind {
+    BUFFER_HEAP,              // aligned_alloc()
+    BUFFER_MAPPED,            // anonymous mapping with MADV_HUGEPAGE
+    BUFFER_HUGETLB,           // anonymous mapping with MAP_HUGETLB
+};
+
+// Lies in the IMAGE_ALIGN bytes in front of every buffer
+struct buffer_header {
+    size_t capacity;          // usable bytes behind the header
+    void* base;               // start of the allocation or mapping
+    size_t length;            // bytes of the mapping
+    enum buffer_kind kind;
+};
+
+_Static_assert(sizeof(struct buffer_header) <= IMAGE_ALIGN, "the header must fit in front of an aligned buffer");
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static struct buffer_header* cached[BUFPOOL_MAX_CACHED];
+static size_t cached_count;
+static size_t cached_bytes;
+static struct bufpool_stats totals;
+
+static size_t round_up(size_t value, size_t multiple){
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+// Maps a buffer on huge pages, returns NULL if there is no memory
+static struct buffer_header* map_buffer(size_t size){
+    size_t length = round_up(size + IMAGE_ALIGN, BUFPOOL_HUGE_PAGE);
+    enum buffer_kind kind = BUFFER_HUGETLB;
+    uint8_t* base = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (base == MAP_FAILED) {
+        // No reserved huge pages: map one huge page more than needed and cut it to a huge page boundary, so the
+        // transparent huge pages can cover the whole buffer
+        kind = BUFFER_MAPPED;
+        uint8_t* raw = mmap(NULL, length + BUFPOOL_HUGE_PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED) {
+            return NULL;
+        }
+        base = (uint8_t*)round_up((uintptr_t)raw, BUFPOOL_HUGE_PAGE);
+        if (base > raw) {
+            munmap(raw, (size_t)(base - raw));
+        }
+        munmap(base + length, (size_t)(raw + BUFPOOL_HUGE_PAGE - base));
+        madvise(base, length, MADV_HUGEPAGE);
+    }
+
+    struct buffer_header* header = (struct buffer_header*)base;
+    header->capacity = length - IMAGE_ALIGN;
+    header->base = base;
+    header->length = length;
+    header->kind = kind;
+    return header;
+}
+
+static struct buffer_header* alloc_buffer(size_t size){
+    if (size >= BUFPOOL_HUGE_THRESHOLD) {
+        return map_buffer(size);
+    }
+    size_t length = round_up(size + IMAGE_ALIGN, IMAGE_ALIGN);
+    struct buffer_header* header = aligned_alloc(IMAGE_ALIGN, length);
+    if (!header) {
+        return NULL;
+    }
+    header->capacity = length - IMAGE_ALIGN;
+    header->base = header;
+    header->length = length;
+    header->kind = BUFFER_HEAP;
+    return header;
+}
+
+static void release_buffer(struct buffer_header* header){
+    if (header->kind == BUFFER_HEAP) {
+        free(header->base);
+    } else {
+        munmap(header->base, header->length);
+    }
+}
+
+/*
+ * Returns a buffer of at least size bytes that starts at a multiple of IMAGE_ALIGN, or NULL if there is no memory.
+ *
+ * The smallest released buffer that holds size bytes is reused if it isn't more than twice as large; its content is
+ * whatever the previous user left. The buffer is given back with bufpool_put().
+ */
+uint8_t* bufpool_get(size_t size){
+    struct buffer_header* header = NULL;
+
+    pthread_mutex_lock(&lock);
+    size_t best = cached_count;
+    for (size_t i = 0; i < cached_count; i++) {
+        size_t capacity = cached[i]->capacity;
+        if (capacity >= size && capacity / 2 <= size && (best == cached_count || capacity < cached[best]->capacity)) {
+            best = i;
+        }
+    }
+    if (best < cached_count) {
+        header = cached[best];
+        cached[best] = cached[--cached_count];
+        cached_bytes -= header->length;
+        totals.reuses++;
+    }
+    pthread_mutex_unlock(&lock);
+    if (header) {
+        return (uint8_t*)header + IMAGE_ALIGN;
+    }
+
+    header = alloc_buffer(size);
+    if (!header) {
+        return NULL;
+    }
+    pthread_mutex_lock(&lock);
+    totals.allocations++;
+    totals.bytes += header->length;
+    totals.hugetlb += header->kind == BUFFER_HUGETLB;
+    totals.advised += header->kind == BUFFER_MAPPED;
+    pthread_mutex_unlock(&lock);
+    return (uint8_t*)header + IMAGE_ALIGN;
+}
+
+// Gives a buffer of bufpool_get() back for reuse, NULL is ignored
+void bufpool_put(uint8_t* buffer){
+    if (!buffer) {
+        return;
+    }
+    struct buffer_header* header = (struct buffer_header*)(buffer - IMAGE_ALIGN);
+
+    pthread_mutex_lock(&lock);
+    int keep = cached_count < BUFPOOL_MAX_CACHED && cached_bytes + header->length <= BUFPOOL_MAX_CACHED_BYTES;
+    if (keep) {
+        cached[cached_count++] = header;
+        cached_bytes += header->length;
+    }
+    pthread_mutex_unlock(&lock);
+    if (!keep) {
+        release_buffer(header);
+    }
+}
+
+// Returns all released buffers to the system
+void bufpool_trim(void){
+    pthread_mutex_lock(&lock);
+    for (size_t i = 0; i < cached_count; i++) {
+        release_buffer(cached[i]);
+    }
+    cached_count = 0;
+    cached_bytes = 0;
+    pthread_mutex_unlock(&lock);
+}
+
+// Allocation counters since the start of the process together with its page faults
+void bufpool_stats(struct bufpool_stats* stats){
+    pthread_mutex_lock(&lock);
+    *stats = totals;
+    stats->cached = cached_count;
+    pthread_mutex_unlock(&lock);
+
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        stats->minor_faults = usage.ru_minflt;
+        stats->major_faults = usage.ru_majflt;
+    }
+}
@@ -0,0 +1,29 @@
+#ifndef BUFPOOL_H
+#define BUFPOOL_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+// Buffers from this size on are mapped separately and backed by huge pages where possible
+#define BUFPOOL_HUGE_THRESHOLD (4u << 20)
+#define BUFPOOL_HUGE_PAGE (2u << 20)
+// Released buffers kept for reuse, enough for every image in flight in batch mode
+#define BUFPOOL_MAX_CACHED 32
+
+struct bufpool_stats {
+    size_t allocations;      // buffers obtained from the system
+    size_t reuses;           // requests served by a released buffer
+    size_t bytes;            // bytes obtained from the system in total
+    size_t hugetlb;          // buffers mapped with MAP_HUGETLB
+    size_t advised;          // buffers mapped with MADV_HUGEPAGE (transparent huge pages)
+    size_t cached;           // released buffers currently waiting for reuse
+    long minor_faults;       // page faults of the whole process so far (getrusage)
+    long major_faults;
+};
+
+uint8_t* bufpool_get(size_t size);
+void bufpool_put(uint8_t* buffer);
+void bufpool_trim(void);
+void bufpool_stats(struct bufpool_stats* stats);
+
+#endif  // BUFPOOL_H
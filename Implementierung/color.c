@@ -0,0 +1,38 @@
+#include <stdint.h>
+#include "kernel_tables.h"
+#include "color.h"
+
+// Treats input and output without gaps between the rows as one row
+static void color_flatten(size_t* width, size_t* height, size_t stride, size_t result_stride){
+    if (stride == *width * 3 && result_stride == *width * 3) {
+        *width *= *height;
+        *height = *height > 0 ? 1 : 0;
+    }
+}
+
+/*
+ * Scalar color mode: every byte of the interleaved RGB rows is mapped through the table, R, G and B alike.
+ */
+void gamma_color(const uint8_t* img, size_t width, size_t height, size_t stride, float a, float b, float c, float gamma, uint8_t* result, size_t result_stride, const struct kernel_tables* tables){
+    (void)a; (void)b; (void)c; (void)gamma;
+    const uint8_t* table = tables->gamma;
+
+    color_flatten(&width, &height, stride, result_stride);
+    for (size_t y = 0; y < height; y++) {
+        const uint8_t* row = img + y * stride;
+        uint8_t* out = result + y * result_stride;
+        for (size_t i = 0; i < width * 3; i++) {
+            out[i] = table[row[i]];
+        }
+    }
+}
+
+// The widest color kernel the CPU (and --isa) allows. There is none for SSE4.1: its pshufb lookup needs 16 shuffles
+// per 16 bytes and was slower than the scalar loop, which SSE4.1 machines run instead.
+gamma_kernel select_color_kernel(void){
+    enum isa_level isa = cpu_active_isa();
+    if (isa >= ISA_AVX512 && cpu_has_vbmi()) {
+        return gamma_color_avx512;
+    }
+    return isa >= ISA_AVX2 ? gamma_color_avx2 : gamma_color;
+}
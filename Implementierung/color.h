@@ -0,0 +1,19 @@
+#ifndef COLOR_H
+#define COLOR_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "cpu_dispatch.h"
+
+/*
+ * Kernels of the color mode (--color): gamma correction of every channel, the result is an RGB image again. They have
+ * the gamma_kernel signature so the thread pool and the benchmark run them unchanged; a, b, c and gamma are not used
+ * (the table of the plan, tables->gamma with the --ops fused in, is shared by all channels) and result_stride is in
+ * bytes like stride, width * 3 without padding.
+ */
+void gamma_color(const uint8_t* img, size_t width, size_t height, size_t stride, float a, float b, float c, float gamma, uint8_t* result, size_t result_stride, const struct kernel_tables* tables);
+void gamma_color_avx2(const uint8_t* img, size_t width, size_t height, size_t stride, float a, float b, float c, float gamma, uint8_t* result, size_t result_stride, const struct kernel_tables* tables);
+void gamma_color_avx512(const uint8_t* img, size_t width, size_t height, size_t stride, float a, float b, float c, float gamma, uint8_t* result, size_t result_stride, const struct kernel_tables* tables);
+gamma_kernel select_color_kernel(void);
+
+#endif  // COLOR_H
@@ -0,0 +1,64 @@
+#pragma GCC target("avx2")
+#include <immintrin.h>
+#include <stdint.h>
+#include "kernel_tables.h"
+#include "color.h"
+
+/*
+ * Looks up 32 bytes in a 256 entry table held in 16 registers of 16 entries each (both lanes hold the same entries).
+ *
+ * pshufb selects by the low four bits of every index byte, so one shuffle per register gives the 16 candidates of every
+ * byte, one for each value of the high four bits. A tree of blends then picks the right one: the first level chooses
+ * between neighbouring registers by bit 4 of the index, the next ones by bits 5, 6 and 7. blendv tests the top bit of
+ * every byte, a 16 bit shift left by 3, 2, 1 and 0 moves bit 4 to 7 there without mixing neighbouring bytes. That is
+ * 16 shuffles and 15 blends per 32 bytes instead of a saturating add, a shuffle, an or and a subtract per register.
+ */
+static inline __m256i lookup32(__m256i v, const __m256i* chunks){
+    __m256i index = _mm256_and_si256(v, _mm256_set1_epi8(0x0f));
+    __m256i t[16];
+    for (int k = 0; k < 16; k++) {
+        t[k] = _mm256_shuffle_epi8(chunks[k], index);
+    }
+    for (int level = 0, count = 8; count > 0; level++, count /= 2) {
+        __m256i select = _mm256_slli_epi16(v, 3 - level);
+        for (int k = 0; k < count; k++) {
+            t[k] = _mm256_blendv_epi8(t[2 * k], t[2 * k + 1], select);
+        }
+    }
+    return t[0];
+}
+
+/*
+ * Color mode with pshufb lookups directly on the interleaved bytes: there is nothing to deinterleave because every
+ * channel uses the same table. With padded rows (image_alloc() with 3 bytes per pixel for input and output, see
+ * kernel_tables.padded) the last vector of a row runs into the padding, otherwise the rest of the row is done with
+ * scalar lookups.
+ */
+void gamma_color_avx2(const uint8_t* img, size_t width, size_t height, size_t stride, float a, float b, float c, float gamma, uint8_t* result, size_t result_stride, const struct kernel_tables* tables){
+    (void)a; (void)b; (void)c; (void)gamma;
+    const uint8_t* table = tables->gamma;
+    __m256i chunks[16];
+    for (int k = 0; k < 16; k++) {
+        chunks[k] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)(table + k * 16)));
+    }
+
+    int padded = tables->padded;
+    if (stride == width * 3 && result_stride == width * 3) {
+        width *= height;
+        height = height > 0 ? 1 : 0;
+    }
+    size_t bytes = width * 3;
+    for (size_t y = 0; y < height; y++) {
+        const uint8_t* row = img + y * stride;
+        uint8_t* out = result + y * result_stride;
+
+        size_t i = 0;
+        for (; padded ? i < bytes : i + 32 <= bytes; i += 32) {
+            __m256i v = _mm256_loadu_si256((const __m256i*)(row + i));
+            _mm256_storeu_si256((__m256i*)(out + i), lookup32(v, chunks));
+        }
+        for (; i < bytes; i++) {
+            out[i] = table[row[i]];
+        }
+    }
+}
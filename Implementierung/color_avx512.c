@@ -0,0 +1,39 @@
+#pragma GCC target("avx512f,avx512bw,avx512vbmi")
+#include <immintrin.h>
+#include <stdint.h>
+#include "kernel_tables.h"
+#include "color.h"
+
+/*
+ * Color mode with AVX-512 VBMI: vpermi2b looks up 64 bytes in a 128 entry table held in two registers, so the whole
+ * table fits into four registers and a lookup is two permutes (low and high half of the table) and a blend on the
+ * high bit of the index. The end of a row is handled with masked loads and stores, which never touch memory outside
+ * the mask, so there is no scalar remainder and no padding is needed.
+ */
+void gamma_color_avx512(const uint8_t* img, size_t width, size_t height, size_t stride, float a, float b, float c, float gamma, uint8_t* result, size_t result_stride, const struct kernel_tables* tables){
+    (void)a; (void)b; (void)c; (void)gamma;
+    const uint8_t* table = tables->gamma;
+    __m512i t0 = _mm512_loadu_si512(table);
+    __m512i t1 = _mm512_loadu_si512(table + 64);
+    __m512i t2 = _mm512_loadu_si512(table + 128);
+    __m512i t3 = _mm512_loadu_si512(table + 192);
+
+    if (stride == width * 3 && result_stride == width * 3) {
+        width *= height;
+        height = height > 0 ? 1 : 0;
+    }
+    size_t bytes = width * 3;
+    for (size_t y = 0; y < height; y++) {
+        const uint8_t* row = img + y * stride;
+        uint8_t* out = result + y * result_stride;
+
+        for (size_t i = 0; i < bytes; i += 64) {
+            __mmask64 mask = bytes - i >= 64 ? ~(__mmask64)0 : ((__mmask64)1 << (bytes - i)) - 1;
+            __m512i v = _mm512_maskz_loadu_epi8(mask, row + i);
+            __m512i low = _mm512_permutex2var_epi8(t0, v, t1);
+            __m512i high = _mm512_permutex2var_epi8(t2, v, t3);
+            __m512i r = _mm512_mask_blend_epi8(_mm512_movepi8_mask(v), low, high);
+            _mm512_mask_storeu_epi8(out + i, mask, r);
+        }
+    }
+}
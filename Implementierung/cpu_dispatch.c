@@ -0,0 +1,62 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cpu_dispatch.h"
+
+static enum isa_level isa_limit = ISA_AVX512;    // upper bound set with --isa
+
+static const char* isa_names[] = {
+    [ISA_SCALAR] = "scalar",
+    [ISA_SSE41] = "sse4.1",
+    [ISA_AVX2] = "avx2",
+    [ISA_AVX512] = "avx512",
+};
+
+// Queries cpuid (through the compiler builtins) once and returns the widest instruction set the kernels can use
+enum isa_level cpu_detect_isa(void){
+    static int detected = -1;
+    if(detected < 0){
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")){
+            detected = ISA_AVX512;
+        }else if(__builtin_cpu_supports("avx2")){
+            detected = ISA_AVX2;
+        }else if(__builtin_cpu_supports("sse4.1")){
+            detected = ISA_SSE41;
+        }else{
+            detected = ISA_SCALAR;
+        }
+    }
+    return (enum isa_level)detected;
+}
+
+// Restricts the dispatcher to at most the given instruction set, e.g. to compare kernels on the same machine
+void cpu_limit_isa(enum isa_level limit){
+    isa_limit = limit;
+}
+
+enum isa_level cpu_active_isa(void){
+    enum isa_level detected = cpu_detect_isa();
+    return detected < isa_limit ? detected : isa_limit;
+}
+
+// AVX-512 VBMI (byte permutes across the whole register) is not part of the avx512 level, it is checked separately
+int cpu_has_vbmi(void){
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx512vbmi");
+}
+
+const char* cpu_isa_name(enum isa_level isa){
+    return isa_names[isa];
+}
+
+// Converts an --isa argument to its level, returns 0 if the name is unknown
+int cpu_parse_isa(const char* name, enum isa_level* isa){
+    for(size_t i = 0; i < sizeof(isa_names) / sizeof(isa_names[0]); i++){
+        if(strcmp(name, isa_names[i]) == 0){
+            *isa = (enum isa_level)i;
+            return 1;
+        }
+    }
+    return 0;
+}
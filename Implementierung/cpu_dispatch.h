@@ -0,0 +1,27 @@
+#ifndef CPU_DISPATCH_H
+#define CPU_DISPATCH_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+struct kernel_tables;
+
+// Common signature of all gamma_V* implementations
+typedef void (*gamma_kernel)(const uint8_t* img, size_t width, size_t height, size_t stride, float a, float b, float c, float gamma, uint8_t* result, size_t result_stride, const struct kernel_tables* tables);
+
+// Instruction set levels, ordered from narrowest to widest
+enum isa_level {
+    ISA_SCALAR,
+    ISA_SSE41,
+    ISA_AVX2,
+    ISA_AVX512,
+};
+
+enum isa_level cpu_detect_isa(void);
+void cpu_limit_isa(enum isa_level limit);
+enum isa_level cpu_active_isa(void);
+int cpu_has_vbmi(void);
+const char* cpu_isa_name(enum isa_level isa);
+int cpu_parse_isa(const char* name, enum isa_level* isa);
+
+#endif  // CPU_DISPATCH_H
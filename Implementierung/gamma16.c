@@ -0,0 +1,65 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include "gamma_V6.h"
+#include "image.h"
+#include "gamma16.h"
+#include "kernel_tables.h"
+
+// Fills the table of gamma16_table: entry i is the corrected value of the gray value i, max_val + 1 entries
+void buildGammaTable16(float gamma, int max_val, uint16_t* table){
+    float max = (float)max_val;
+    for (int i = 0; i <= max_val; i++) {
+        float corrected = powf((float)i / max, gamma) * max;
+        table[i] = (uint16_t)fminf(fmaxf(corrected, 0.0f), max);
+    }
+}
+
+/*
+ * Reference for 16 bit images, gamma_V0 with the max value of the image instead of 255.
+ */
+void gamma16_V0(const uint8_t* img, size_t width, size_t height, size_t stride, float a, float b, float c, float gamma, uint8_t* result, size_t result_stride, const struct kernel_tables* tables){
+    float max = (float)tables->max_val;
+    for (size_t y = 0; y < height; y++) {
+        const uint16_t* row = (const uint16_t*)(img + y * stride);
+        uint16_t* out = (uint16_t*)(result + y * result_stride);
+        for (size_t x = 0; x < width; x++) {
+            float gray = (a * row[x * 3] + b * row[x * 3 + 1] + c * row[x * 3 + 2]) / (a + b + c);
+            float corrected = powf(gray / max, gamma) * max;
+            out[x] = (uint16_t)fminf(fmaxf(corrected, 0.0f), max);
+        }
+    }
+}
+
+/*
+ * Table version for 16 bit images: fixed-point grayscale conversion (the weights of gamma_V6) and a table with one
+ * entry per possible gray value.
+ *
+ * Description:
+ * The table has max value + 1 entries (at most 65536, 128 KiB, which stays in L2). It is built once per plan with
+ * buildGammaTable16() (tables->gamma16) and shared by all bands and images, so the kernel itself only does the gray
+ * conversion and the lookup. The gray value is rounded to an integer before the lookup, which at 16 bit is a much
+ * smaller error than at 8 bit. The sums of the 2.14 weights times 16 bit samples fit into 32 bits, so the gray loop has
+ * no overflow and is vectorised by the compiler.
+ */
+void gamma16_table(const uint8_t* img, size_t width, size_t height, size_t stride, float a, float b, float c, float gamma, uint8_t* result, size_t result_stride, const struct kernel_tables* tables){
+    (void)gamma;
+    const uint16_t* table = tables->gamma16;
+    size_t entries = (size_t)tables->max_val + 1;
+
+    int16_t w[3];
+    fixedPointWeights(a, b, c, w);
+    uint32_t wr = (uint32_t)w[0], wg = (uint32_t)w[1], wb = (uint32_t)w[2];
+    const uint32_t round = 1u << (GAMMA_V6_SHIFT - 1);
+
+    image_flatten16(&width, &height, stride, result_stride);
+    for (size_t y = 0; y < height; y++) {
+        const uint16_t* row = (const uint16_t*)(img + y * stride);
+        uint16_t* out = (uint16_t*)(result + y * result_stride);
+        for (size_t x = 0; x < width; x++) {
+            uint32_t gray = (wr * row[x * 3] + wg * row[x * 3 + 1] + wb * row[x * 3 + 2] + round) >> GAMMA_V6_SHIFT;
+            out[x] = table[gray < entries ? gray : entries - 1];
+        }
+    }
+}
@@ -0,0 +1,20 @@
+#ifndef GAMMA16_H
+#define GAMMA16_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+struct kernel_tables;
+
+void buildGammaTable16(float gamma, int max_val, uint16_t* table);
+
+/*
+ * Kernels for 16 bit images (max value above 255). They have the gamma_kernel signature, so the thread pool, the
+ * benchmark and the autotuner run them unchanged: img and result hold 16 bit samples in host byte order and both
+ * strides are in bytes, width * 6 and width * 2 without padding. The max value of the image is tables->max_val.
+ */
+void gamma16_V0(const uint8_t* img, size_t width, size_t height, size_t stride, float a, float b, float c, float gamma, uint8_t* result, size_t result_stride, const struct kernel_tables* tables);
+void gamma16_table(const uint8_t* img, size_t width, size_t height, size_t stride, float a, float b, float c, float gamma, uint8_t* result, size_t result_stride, const struct kernel_tables* tables);
+void gamma16_V4(const uint8_t* img, size_t width, size_t height, size_t stride, float a, float b, float c, float gamma, uint8_t* result, size_t result_stride, const struct kernel_tables* tables);
+
+#endif  // GAMMA16_H
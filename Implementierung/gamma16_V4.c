@@ -0,0 +1,83 @@
+#pragma GCC target("sse4.1")
+#include <emmintrin.h>
+#include <smmintrin.h>
+#include <stdint.h>
+#include "fastpow.h"
+#include "image.h"
+#include "gamma_V4.h"
+#include "gamma16.h"
+#include "kernel_tables.h"
+
+/*
+ * gamma_V4 for 16 bit images: four pixels per iteration with the range-reduced pow of fastpow.h.
+ *
+ * Description:
+ * Four RGB pixels are 24 bytes, they are loaded with two 16 byte loads. pshufb moves every 16 bit sample into the low
+ * half of a 32 bit lane and zeroes the high half, the samples of the second load are or-ed into the last lanes. The
+ * arithmetic is the one of gamma_V4 with the max value of the plan (tables->max_val) instead of 255; the four results are truncated,
+ * limited to the max value and packed into 8 bytes with packus. Without padding the loads need 32 bytes, so the last
+ * pixels of every row (at least one, at most five) are done with the scalar fast_powf().
+ */
+static inline __attribute__((always_inline)) void gamma16_V4_precision(const uint8_t* img, size_t width, size_t height, size_t stride, float a, float b, float c, float gamma, uint8_t* result, size_t result_stride, int max_val, int padded, enum pow_precision precision) {
+    float max = (float)max_val;
+    __m128 va = _mm_set1_ps(a);
+    __m128 vb = _mm_set1_ps(b);
+    __m128 vc = _mm_set1_ps(c);
+    __m128 vsum = _mm_set1_ps(a + b + c);
+    __m128 vgamma = _mm_set1_ps(gamma);
+    __m128 vmax = _mm_set1_ps(max);
+    __m128 v1_div_max = _mm_set1_ps(1.0f / max);
+
+    // Bytes of the samples R0 G0 B0 R1 G1 B1 R2 G2 | B2 R3 G3 B3 in the two loads, -1 zeroes the byte
+    const __m128i r_lo = _mm_setr_epi8(0, 1, -1, -1, 6, 7, -1, -1, 12, 13, -1, -1, -1, -1, -1, -1);
+    const __m128i r_hi = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 3, -1, -1);
+    const __m128i g_lo = _mm_setr_epi8(2, 3, -1, -1, 8, 9, -1, -1, 14, 15, -1, -1, -1, -1, -1, -1);
+    const __m128i g_hi = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 4, 5, -1, -1);
+    const __m128i b_lo = _mm_setr_epi8(4, 5, -1, -1, 10, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i b_hi = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, 0, 1, -1, -1, 6, 7, -1, -1);
+
+    image_flatten16(&width, &height, stride, result_stride);
+
+    for (size_t y = 0; y < height; y++) {
+        const uint8_t* row = img + y * stride;
+        uint16_t* out = (uint16_t*)(result + y * result_stride);
+
+        size_t x = 0;
+        for (; padded ? x < width : x + 6 <= width; x += 4) {
+            __m128i lo = _mm_loadu_si128((const __m128i*)(row + x * 6));
+            __m128i hi = _mm_loadu_si128((const __m128i*)(row + x * 6 + 16));
+
+            __m128 Rf = _mm_cvtepi32_ps(_mm_or_si128(_mm_shuffle_epi8(lo, r_lo), _mm_shuffle_epi8(hi, r_hi)));
+            __m128 Gf = _mm_cvtepi32_ps(_mm_or_si128(_mm_shuffle_epi8(lo, g_lo), _mm_shuffle_epi8(hi, g_hi)));
+            __m128 Bf = _mm_cvtepi32_ps(_mm_or_si128(_mm_shuffle_epi8(lo, b_lo), _mm_shuffle_epi8(hi, b_hi)));
+
+            __m128 gray = _mm_div_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(va, Rf), _mm_mul_ps(vb, Gf)), _mm_mul_ps(vc, Bf)), vsum);
+            __m128 corrected = _mm_mul_ps(fast_pow_sse(_mm_mul_ps(gray, v1_div_max), vgamma, precision), vmax);
+            corrected = _mm_min_ps(corrected, vmax);
+
+            __m128i corrected32 = _mm_cvttps_epi32(corrected);
+            _mm_storel_epi64((__m128i*)(out + x), _mm_packus_epi32(corrected32, corrected32));
+        }
+
+        for (; x < width; x++) {
+            const uint16_t* pixel = (const uint16_t*)(row + x * 6);
+            float gray = (a * pixel[0] + b * pixel[1] + c * pixel[2]) / (a + b + c);
+            float corrected = fast_powf(gray / max, gamma, precision) * max;
+            out[x] = (uint16_t)(corrected < max ? corrected : max);
+        }
+    }
+}
+
+void gamma16_V4(const uint8_t* img, size_t width, size_t height, size_t stride, float a, float b, float c, float gamma, uint8_t* result, size_t result_stride, const struct kernel_tables* tables) {
+    switch (getPowPrecision()) {
+        case POW_LOW:
+            gamma16_V4_precision(img, width, height, stride, a, b, c, gamma, result, result_stride, tables->max_val, tables->padded, POW_LOW);
+            break;
+        case POW_MEDIUM:
+            gamma16_V4_precision(img, width, height, stride, a, b, c, gamma, result, result_stride, tables->max_val, tables->padded, POW_MEDIUM);
+            break;
+        default:
+            gamma16_V4_precision(img, width, height, stride, a, b, c, gamma, result, result_stride, tables->max_val, tables->padded, POW_HIGH);
+            break;
+    }
+}
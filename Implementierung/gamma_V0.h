@@ -4,7 +4,9 @@
 #include <stdlib.h>
 #include <math.h>
 
+struct kernel_tables;
 
-void gamma_V0(const uint8_t* img, size_t width, size_t height, float a, float b, float c, float gamma, uint8_t* result);
+
+void gamma_V0(const uint8_t* img, size_t width, size_t height, size_t stride, float a, float b, float c, float gamma, uint8_t* result, size_t result_stride, const struct kernel_tables* tables);
 
 #endif /* GAMMA_CORRECTION_H */
@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <math.h>
 #include <stdio.h>
+#include "gamma_V1.h"
 
 
 //This is the implementation that uses basic mathematic operators to calculate the power 
@@ -65,12 +66,13 @@ double power(double base, double exponent){
 }
 
 
-void gamma_V1(const uint8_t* img, size_t width, size_t height,float a, float b, float c,float gamma,uint8_t* result){
+void gamma_V1(const uint8_t* img, size_t width, size_t height, size_t stride, float a, float b, float c, float gamma, uint8_t* result, size_t result_stride, const struct kernel_tables* tables){
+    (void)tables;
     //iterating through the 'array' pixels and for each of them applying the gamma-korrektur algorithm as described 
     for(size_t i = 0; i < height; i++){
         for(size_t j = 0; j < width; j++){
 
-            size_t position = (i * width + j) * 3; //the starting index for each pixel
+            size_t position = i * stride + j * 3; //the starting index for each pixel
             float R = img[position]; //the red color
             float G = img[position + 1]; //the green color
             float B = img[position + 2]; //the blue color
@@ -84,7 +86,7 @@ void gamma_V1(const uint8_t* img, size_t width, size_t height,float a, float b,
             uint8_t pixel_val = (uint8_t)fminf(fmaxf(result_1,0), 255);
 
             //recreating the result file from the input 
-            result[i * width + j] = pixel_val;
+            result[i * result_stride + j] = pixel_val;
             }
         }
 }   
\ No newline at end of file
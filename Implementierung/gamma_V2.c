@@ -1,13 +1,17 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <math.h>
+#include "image.h"
 #include "gamma_V2.h"
+#include "kernel_tables.h"
 
 /* 
 This implementation contains 2 helper functions:
 1. convertToGrayscale - it converts an image and its pixels to grayscale only
 2. applyGammaCorrection - it applies gamma correction on a grayscale image 
 3. gamma_korrektur - is the "main" function  that calls the two helper functions mentioned above
+4. gamma_V2_tiled - runs the grayscale pass and a table pass strip by strip, so the second pass finds its input still in the cache
+5. convertToGrayscaleHistogram - the first pass of --gamma auto, convertToGrayscale that also counts the gray values
 
 In this implementation: Using the fact that a^b = pow(a,b) = exp(b * log(a)), using two
 other mathematical functions from math.h to have diversity between implementations
@@ -52,12 +56,112 @@ void applyGammaCorrection(uint8_t* first_img, size_t width, size_t height, float
     }
 }
 
-void gamma_V2(const uint8_t* img, size_t width, size_t height, float a, float b, float c, float gamma, uint8_t* result){
+void gamma_V2(const uint8_t* img, size_t width, size_t height, size_t stride, float a, float b, float c, float gamma, uint8_t* result, size_t result_stride, const struct kernel_tables* tables){
+    (void)tables;
+    image_flatten(&width, &height, stride, result_stride);
 
-    //First, convert the img to grayscale
-    convertToGrayscale(img, width, height, a, b, c, result);
+    //First, convert the whole img to grayscale
+    for(size_t y = 0; y < height; y++){
+        convertToGrayscale(img + y * stride, width, 1, a, b, c, result + y * result_stride);
+    }
+
+    //Then, apply gamma correction on the whole grayscaled img; padded rows get the same two passes as one flat row
+    for(size_t y = 0; y < height; y++){
+        applyGammaCorrection(result + y * result_stride, width, 1, gamma, result + y * result_stride);
+    }
+}
+
+
+static size_t tileSize = GAMMA_V2_DEFAULT_TILE;   //pixels per strip of gamma_V2_tiled, set with --tile
+
+void setTileSize(size_t pixels){
+    tileSize = pixels > 0 ? pixels : GAMMA_V2_DEFAULT_TILE;
+}
 
-    //Then, apply gamma correction on the grayscaled img 
-    applyGammaCorrection(result, width, height, gamma,result);
+/*
+ * Converts an image to gray and applies gamma correction in two passes per strip of tileSize pixels.
+ *
+ * Description:
+ * The first pass is the weighted sum of convertToGrayscale with normalised weights, truncated to 8 bit like there; the
+ * second one maps the gray strip through the gamma table of the plan (tables->gamma, with the --ops fused in) instead
+ * of evaluating expf/logf per pixel, so both passes are cheap enough that the traffic of the gray intermediate matters. The strip written by the first pass is read back by the second one while it is still in L1
+ * instead of after the whole image went through DRAM. A tile size of at least the image size gives the untiled two-pass
+ * order of gamma_V2 for comparison.
+ */
+void gamma_V2_tiled(const uint8_t* img, size_t width, size_t height, size_t stride, float a, float b, float c, float gamma, uint8_t* result, size_t result_stride, const struct kernel_tables* tables){
+    (void)gamma;
+    const uint8_t* table = tables->gamma;
+    float sum = a + b + c;
+    float scale = sum > 0 ? 1.0f / sum : 0;
+    float wa = a * scale;
+    float wb = b * scale;
+    float wc = c * scale;
+
+    image_flatten(&width, &height, stride, result_stride);
+    for(size_t y = 0; y < height; y++){
+        const uint8_t* row = img + y * stride;
+        uint8_t* out = result + y * result_stride;
+        for(size_t start = 0; start < width; start += tileSize){
+            size_t count = width - start < tileSize ? width - start : tileSize;
+            uint8_t* strip = out + start;
+
+            //the weights are normalised once, so the gray pass has no division
+            const uint8_t* pixels = row + start * 3;
+            for(size_t i = 0; i < count; i++){
+                float d = wa * pixels[i * 3] + wb * pixels[i * 3 + 1] + wc * pixels[i * 3 + 2];
+                strip[i] = (uint8_t)(int)d;
+            }
+            for(size_t i = 0; i < count; i++){
+                strip[i] = table[strip[i]];
+            }
+        }
+    }
 }
 
+/*
+ * Converts an image to grayscale like convertToGrayscale and counts the gray values.
+ *
+ * Parameters:
+ *  - const uint8_t* img, size_t width, size_t height, size_t stride: The RGB image, stride in bytes.
+ *  - float a, b, c: Coefficients of the grayscale conversion.
+ *  - uint8_t* gray, size_t gray_stride: Receives the gray image, stride in bytes.
+ *  - uint32_t* histogram: 256 counters, the counts of this image are added.
+ *
+ * Description:
+ * The image is converted strip by strip as in gamma_V2_tiled and every strip is counted right after it was written,
+ * while it is still in L1, so the RGB input is read only once. Consecutive equal gray values are common in images and
+ * incrementing the same counter again has to wait for the previous store; the pixels are therefore counted round robin
+ * into GAMMA_V2_HISTOGRAMS separate histograms that are added up at the end.
+ */
+void convertToGrayscaleHistogram(const uint8_t* img, size_t width, size_t height, size_t stride, float a, float b, float c, uint8_t* gray, size_t gray_stride, uint32_t* histogram){
+    uint32_t counts[GAMMA_V2_HISTOGRAMS][256] = {{0}};
+
+    image_flatten(&width, &height, stride, gray_stride);
+    for(size_t y = 0; y < height; y++){
+        const uint8_t* row = img + y * stride;
+        uint8_t* out = gray + y * gray_stride;
+        for(size_t start = 0; start < width; start += GAMMA_V2_DEFAULT_TILE){
+            size_t count = width - start < GAMMA_V2_DEFAULT_TILE ? width - start : GAMMA_V2_DEFAULT_TILE;
+            const uint8_t* strip = out + start;
+
+            convertToGrayscale(row + start * 3, count, 1, a, b, c, out + start);
+
+            size_t i = 0;
+            for(; i + 4 <= count; i += 4){
+                counts[0][strip[i]]++;
+                counts[1][strip[i + 1]]++;
+                counts[2][strip[i + 2]]++;
+                counts[3][strip[i + 3]]++;
+            }
+            for(; i < count; i++){
+                counts[0][strip[i]]++;
+            }
+        }
+    }
+
+    for(size_t k = 0; k < GAMMA_V2_HISTOGRAMS; k++){
+        for(size_t v = 0; v < 256; v++){
+            histogram[v] += counts[k][v];
+        }
+    }
+}
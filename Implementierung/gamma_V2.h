@@ -5,8 +5,19 @@
 #include <stdlib.h>
 #include <math.h>
 
+struct kernel_tables;
+
+// Default strip length of gamma_V2_tiled in pixels: 12 KiB of RGB input plus 4 KiB of output fit into L1
+#define GAMMA_V2_DEFAULT_TILE 4096
+
+// Number of separate histograms of convertToGrayscaleHistogram, the unrolled counting loop assumes four
+#define GAMMA_V2_HISTOGRAMS 4
+
 void convertToGrayscale(const uint8_t* img, size_t width, size_t height, float a, float b, float c, uint8_t* first_img);
 void applyGammaCorrection(uint8_t* first_img, size_t width, size_t height, float gamma, uint8_t* result);
-void gamma_V2(const uint8_t* img, size_t width, size_t height, float a, float b, float c, float gamma, uint8_t* result);
+void gamma_V2(const uint8_t* img, size_t width, size_t height, size_t stride, float a, float b, float c, float gamma, uint8_t* result, size_t result_stride, const struct kernel_tables* tables);
+void setTileSize(size_t pixels);
+void convertToGrayscaleHistogram(const uint8_t* img, size_t width, size_t height, size_t stride, float a, float b, float c, uint8_t* gray, size_t gray_stride, uint32_t* histogram);
+void gamma_V2_tiled(const uint8_t* img, size_t width, size_t height, size_t stride, float a, float b, float c, float gamma, uint8_t* result, size_t result_stride, const struct kernel_tables* tables);
 
 #endif  // GAMMA_KORREKTUR_H3
\ No newline at end of file
@@ -1,9 +1,12 @@
+#pragma GCC target("sse4.1")
 #include <emmintrin.h> 
 #include <smmintrin.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <math.h>
+#include "image.h"
+#include "kernel_tables.h"
 #include "gamma_V3.h"
 
 /**
@@ -12,43 +15,38 @@
  * @param img Pointer to the input image.
  * @param width The width of the image in pixels.
  * @param height The height of the image in pixels.
+ * @param stride The distance between two input rows in bytes, width * 3 without padding.
  * @param a The weighting coefficient for the R-channel in the grayscale conversion.
  * @param b The weighting coefficient for the G-channel in the grayscale conversion.
  * @param c The weighting coefficient for the B-channel in the grayscale conversion.
  * @param gamma The gamma value for gamma correction.
  * @param result Pointer to the memory area where the result image will be stored. This memory must already be allocated and have enough space for an image of the same size as the input image.
+ * @param result_stride The distance between two output rows in bytes, width without padding.
  *
  * The function processes four pixels at a time to improve performance through parallelization. Gamma correction is performed at the scalar level for each element in the vector. 
-    For areas of the image that cannot be divided into groups of four pixels (e.g., at the edge of the image), gamma correction is calculated individually for each pixel.
+    For areas of the image that cannot be divided into groups of four pixels (e.g., at the edge of the image), gamma correction is calculated individually for each pixel, unless the image has the row padding of image_alloc().
  */
 
 
-void gamma_V3(const uint8_t* img, size_t width, size_t height, float a, float b, float c, float gamma, uint8_t* result) {
+void gamma_V3(const uint8_t* img, size_t width, size_t height, size_t stride, float a, float b, float c, float gamma, uint8_t* result, size_t result_stride, const struct kernel_tables* tables) {
     __m128 va = _mm_set1_ps(a);
     __m128 vb = _mm_set1_ps(b);
     __m128 vc = _mm_set1_ps(c);
     __m128 vsum = _mm_set1_ps(a + b + c);
     
-    size_t restWidth = 0;
-    size_t restX = 0;
-        
-    size_t processedWidth = width - (width % 4); // Width interpretation as group of four
-
+    int padded = tables->padded;
+    image_flatten(&width, &height, stride, result_stride);
 
     for(size_t y = 0; y < height; y++) {
-        // restWidth >= 6 is a restriction to avoid memory leakage; 
-        // The minimum remaining width length must be >= 5,3 (16 Byte min width length) 
-        restWidth = width;
-        for(size_t x = 0; x < processedWidth && restWidth >= 6; x += 4, restWidth -= 4, restX = x ) { // Processing four pixels
-            size_t idx = (y * width + x) * 3;
-           
-           // For TESTING
-           // printf("width = %u, x = %u, processedWidth = %u, restWidth = %u\n", width, x, processedWidth, restWidth);
-            
-            
-            
+        const uint8_t* row = img + y * stride;
+        uint8_t* out = result + y * result_stride;
+
+        // Without padding x + 6 <= width is a restriction to avoid reading behind the row:
+        // the 16 byte load needs at least 5,3 pixels. With padding the last group reads and writes padding.
+        size_t x = 0;
+        for(; padded ? x < width : x + 6 <= width; x += 4) { // Processing four pixels
             // Load 4 RGB pixel into SIMD register
-            __m128i rgb = _mm_loadu_si128((__m128i*)(img + idx));
+            __m128i rgb = _mm_loadu_si128((__m128i*)(row + x * 3));
 
             //ES WIRD IN BIG ENDIAN GESPEICHERT!!!
             
@@ -96,48 +94,28 @@ void gamma_V3(const uint8_t* img, size_t width, size_t height, float a, float b,
                 ((float*)&gray)[i] = powf(grayValue * 1.0f / 255.0f, gamma) * 255.0f;
             }
 
-            __m128i corrected_gray8bit = _mm_cvtps_epi32(gray);
-            result[y * width + x] =(uint8_t) _mm_extract_epi32(corrected_gray8bit, 0);
-            result[y * width + x + 1] =(uint8_t) _mm_extract_epi32(corrected_gray8bit, 1);
-            result[y * width + x + 2] =(uint8_t) _mm_extract_epi32(corrected_gray8bit, 2);
-            result[y * width + x + 3] =(uint8_t) _mm_extract_epi32(corrected_gray8bit, 3);
+            __m128i corrected_gray8bit = _mm_cvttps_epi32(gray);        // truncated like the scalar tail and gamma_V0
+            out[x] =(uint8_t) _mm_extract_epi32(corrected_gray8bit, 0);
+            out[x + 1] =(uint8_t) _mm_extract_epi32(corrected_gray8bit, 1);
+            out[x + 2] =(uint8_t) _mm_extract_epi32(corrected_gray8bit, 2);
+            out[x + 3] =(uint8_t) _mm_extract_epi32(corrected_gray8bit, 3);
 
         }
-        if((width % 4) == 0 && restWidth < 6){
-            // Edge cases handling -> when width IS div by 4 but restWidth < 6
-            for (size_t x = restX; x < width; x++) {
-                size_t idx = (y * width + x) * 3;
-
-                // Each pixel scalaric calculate
-                float R = img[idx];
-                float G = img[idx + 1];
-                float B = img[idx + 2];
-
-                // Gray scale convertion
-                float gray = (a * R + b * G + c * B) / (a + b + c);
-
-                // Gammacorrektur
-                float corrected_gray = powf(gray / 255.0f, gamma) * 255.0f;
-                result[y * width + x] = (uint8_t)corrected_gray;
-            }
-        }
-        else{
-            // Edge cases handling -> when width is not div by 4
-            for (size_t x = processedWidth; x < width; x++) {
-                size_t idx = (y * width + x) * 3;
-
-                // Each pixel scalaric calculate
-                float R = img[idx];
-                float G = img[idx + 1];
-                float B = img[idx + 2];
-
-                // Gray scale convertion
-                float gray = (a * R + b * G + c * B) / (a + b + c);
-
-                // Gammacorrektur
-                float corrected_gray = powf(gray / 255.0f, gamma) * 255.0f;
-                result[y * width + x] = (uint8_t)corrected_gray;
-            }
+        // Edge cases handling -> the pixels the vector loop did not reach
+        for (; x < width; x++) {
+            const uint8_t* pixel = row + x * 3;
+
+            // Each pixel scalaric calculate
+            float R = pixel[0];
+            float G = pixel[1];
+            float B = pixel[2];
+
+            // Gray scale convertion
+            float gray = (a * R + b * G + c * B) / (a + b + c);
+
+            // Gammacorrektur
+            float corrected_gray = powf(gray / 255.0f, gamma) * 255.0f;
+            out[x] = (uint8_t)corrected_gray;
         }
     }
-}      
+}
@@ -5,6 +5,8 @@
 #include <stdlib.h>
 #include <math.h>
 
-void gamma_V3(const uint8_t* img, size_t width, size_t height, float a, float b, float c, float gamma, uint8_t* result);
+struct kernel_tables;
+
+void gamma_V3(const uint8_t* img, size_t width, size_t height, size_t stride, float a, float b, float c, float gamma, uint8_t* result, size_t result_stride, const struct kernel_tables* tables);
 
 #endif  // GAMMA_KORREKTUR_SSE
\ No newline at end of file
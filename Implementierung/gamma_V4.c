@@ -1,95 +1,50 @@
+#pragma GCC target("sse4.1")
 #include <emmintrin.h> 
 #include <smmintrin.h>
 #include <stdint.h>
+#include <string.h>
+#include "fastpow.h"
+#include "image.h"
+#include "kernel_tables.h"
 #include "gamma_V4.h"
 
-/*
- * Basic approximational approach of the natural logarithm using a Taylor series expansion.
- *
- * Parameters:
- *  - __m128 x: A 128-bit SIMD floating-point vector containing four single-precision floating-point elements.
- *
- * Returns:
- *  - __m128: A 128-bit SIMD floating-point vector containing the approximate natural logarithm of each element in `x`.
- *
- * Description:
- * This function implements a basic approximation of the natural logarithm function for each element in the input vector `x`,
- * utilizing a truncated Taylor series expansion: ln(1 + x) ≈ x - x^2/2 + x^3/3. 
- * The input vector `x` is assumed to be close to 1, as the accuracy of the approximation depends on the proximity of `x` 
- * to 1. This function is designed for performance in SIMD operations and may be used in applications where a high-precision
- * logarithm is not critical, but fast computation is required.
- */
-__m128 log_approx(__m128 x){
-    __m128 one = _mm_set1_ps(1.0f);
-    __m128 x_minus_one = _mm_sub_ps(x, one);
-
-    __m128 term1 = x_minus_one;
-    __m128 term2 = _mm_div_ps(_mm_mul_ps(x_minus_one, x_minus_one), _mm_set1_ps(2.0f));
-    __m128 term3 = _mm_div_ps(_mm_mul_ps(_mm_mul_ps(x_minus_one, x_minus_one), x_minus_one), _mm_set1_ps(3.0f));
-    __m128 term4 = _mm_div_ps(_mm_mul_ps(_mm_mul_ps(_mm_mul_ps(x_minus_one, x_minus_one), x_minus_one), x_minus_one), _mm_set1_ps(4.0f));
-    __m128 term5 = _mm_div_ps(_mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_mul_ps(x_minus_one, x_minus_one), x_minus_one), x_minus_one), x_minus_one), _mm_set1_ps(5.0f));
-    __m128 term6 = _mm_div_ps(_mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_mul_ps(x_minus_one, x_minus_one), x_minus_one), x_minus_one), x_minus_one), x_minus_one), _mm_set1_ps(6.0f));
-
-    // Sum and subtract terms accordingly
-    return _mm_sub_ps(_mm_sub_ps(_mm_add_ps(_mm_add_ps(term1, term3), term5), term2), _mm_add_ps(term4, term6));
+static enum pow_precision precision = POW_MEDIUM;
+
+// Sets the tier of the pow approximation used by all gamma_V4 variants (--precision)
+void setPowPrecision(enum pow_precision p){
+    precision = p;
 }
 
-/*
- * Basic approximational approach of the exponential function using a Taylor series expansion.
- *
- * Parameters:
- *  - __m128 x: A 128-bit SIMD floating-point vector containing four single-precision floating-point elements.
- *
- * Returns:
- *  - __m128: A 128-bit SIMD floating-point vector containing the approximate exponential value of each element in `x`.
- *
- * Description:
- * This function provides an approximation of the exponential function for each element in the input vector `x`, using
- * a truncated Taylor series expansion: e^x ≈ 1 + x + x^2/2 + x^3/6. The function is intended for use in situations where
- * computational efficiency is prioritized over high precision. It leverages SIMD operations to compute the exponential
- * of four single-precision floating-point numbers simultaneously, making it suitable for performance-critical applications
- * that can tolerate approximation errors.
- */
-__m128 exp_approx(__m128 x){
-    __m128 one = _mm_set1_ps(1.0f);
-    __m128 x_squared = _mm_mul_ps(x, x);
-    __m128 x_cubed = _mm_mul_ps(x_squared, x);
-    __m128 x_quartic = _mm_mul_ps(x_cubed, x);
-    __m128 x_quintic = _mm_mul_ps(x_quartic, x); // x^5
-    __m128 x_sextic = _mm_mul_ps(x_quintic, x); // x^6
-
-    __m128 term1 = one;
-    __m128 term2 = x;
-    __m128 term3 = _mm_div_ps(x_squared, _mm_set1_ps(2.0f)); // 2! = 2
-    __m128 term4 = _mm_div_ps(x_cubed, _mm_set1_ps(6.0f)); // 3! = 6
-    __m128 term5 = _mm_div_ps(x_quartic, _mm_set1_ps(24.0f)); // 4! = 24
-    __m128 term6 = _mm_div_ps(x_quintic, _mm_set1_ps(120.0f)); // 5! = 120
-    __m128 term7 = _mm_div_ps(x_sextic, _mm_set1_ps(720.0f)); // 6! = 720
-
-    // Sum all terms
-    return _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(term1, term2), term3), term4), term5), term6), term7);
+enum pow_precision getPowPrecision(void){
+    return precision;
 }
 
 /*
- * Applies gamma correction to an image using SIMD operations and approximation functions for logarithmic and exponential calculations.
+ * Applies gamma correction to an image using SIMD operations and the range-reduced pow approximation of fastpow.h.
  *
  * Parameters:
  *  - const uint8_t* img: Pointer to the input image data in 8-bit unsigned integer format.
  *  - size_t width: The width of the image in pixels.
  *  - size_t height: The height of the image in pixels.
+ *  - size_t stride: Distance between two input rows in bytes, width * 3 without padding.
  *  - float a, b, c: Coefficients for the weighted sum in grayscale conversion, reflecting the human eye's sensitivity to red, green, and blue.
  *  - float gamma: The gamma correction factor.
  *  - uint8_t* result: Pointer to the memory where the gamma-corrected grayscale image will be stored.
+ *  - size_t result_stride: Distance between two output rows in bytes, width without padding.
+ *  - int padded: Input and output rows have the padding of image_alloc() (kernel_tables.padded).
+ *  - enum pow_precision precision: Tier of the pow approximation, a constant in every call so each tier is compiled separately.
  *
  * Description:
  * This function converts an RGB image to grayscale using a weighted sum approach and then applies gamma correction using the specified
  * gamma value. The grayscale conversion takes into account the human eye's different sensitivities to red, green, and blue by using
- * the coefficients `a`, `b`, and `c`. The gamma correction is performed using an approximate logarithm and exponential functions
- * for efficiency. The function processes four pixels simultaneously using SIMD instructions to enhance performance. It is suitable for
+ * the coefficients `a`, `b`, and `c`. The gamma correction is performed with fast_pow_sse(), which splits
+ * the values into exponent and mantissa and evaluates short polynomials for log2 and exp2 instead of dividing. The result is
+ * truncated like in gamma_V0. The function processes four pixels simultaneously using SIMD instructions to enhance performance. It is suitable for
  * applications requiring fast gamma correction where exact precision is not critical. The function handles edge cases where the image
- * width is not a multiple of four by processing the remaining pixels without SIMD instructions.
+ * width is not a multiple of four by processing the remaining pixels without SIMD instructions, unless the image has the
+ * row padding of image_alloc(): then the last group of every row runs into the padding.
  */
-void gamma_V4(const uint8_t* img, size_t width, size_t height, float a, float b, float c, float gamma, uint8_t* result) {
+static inline __attribute__((always_inline)) void gamma_V4_precision(const uint8_t* img, size_t width, size_t height, size_t stride, float a, float b, float c, float gamma, uint8_t* result, size_t result_stride, int padded, enum pow_precision precision) {
     __m128 va = _mm_set1_ps(a);
     __m128 vb = _mm_set1_ps(b);
     __m128 vc = _mm_set1_ps(c);
@@ -98,20 +53,18 @@ void gamma_V4(const uint8_t* img, size_t width, size_t height, float a, float b,
     __m128 v255 = _mm_set1_ps(255.0f);
     __m128 v1_div_255 = _mm_set1_ps(1.0f / 255.0f);
 
-    size_t restWidth = 0;
-    size_t restX = 0;
-        
-    size_t processedWidth = width - (width % 4); // Width interpretation as group of four
+    image_flatten(&width, &height, stride, result_stride);
 
     for(size_t y = 0; y < height; y++) {
-        // restWidth >= 6 is a restriction to avoid memory leakage; 
-        // The minimum remaining width length must be >= 5,3 (16 Byte min width length) 
-        restWidth = width;
-        for(size_t x = 0; x < processedWidth && restWidth >= 6; x += 4, restWidth -= 4, restX = x ) { // Processing four pixels
-            size_t idx = (y * width + x) * 3;
+        const uint8_t* row = img + y * stride;
+        uint8_t* out = result + y * result_stride;
 
+        // Without padding x + 6 <= width is a restriction to avoid reading behind the row:
+        // the 16 byte load needs at least 5,3 pixels. With padding the last group reads and writes padding.
+        size_t x = 0;
+        for(; padded ? x < width : x + 6 <= width; x += 4) { // Processing four pixels
             // Load 4 RGB pixel into SIMD register
-            __m128i rgb = _mm_loadu_si128((__m128i*)(img + idx));
+            __m128i rgb = _mm_loadu_si128((__m128i*)(row + x * 3));
             const __m128i shuffle_mask = _mm_set_epi8(9,6,3,0, 11,8,5,2, 10,7,4,1, 9,6,3,0);
             __m128i r3_r2_r1_r0_b3_b2_b1_b0_g3_g2_g1_g0_r3_r2_r1_r0 = _mm_shuffle_epi8(rgb, shuffle_mask);
 
@@ -134,64 +87,45 @@ void gamma_V4(const uint8_t* img, size_t width, size_t height, float a, float b,
 
             // Applying the gammacorrection
             gray = _mm_mul_ps(gray, v1_div_255);
-            __m128 log_gray = log_approx(gray);
-            __m128 gamma_log_gray = _mm_mul_ps(vgamma, log_gray);
-            __m128 corrected_gray = exp_approx(gamma_log_gray);
+            __m128 corrected_gray = fast_pow_sse(gray, vgamma, precision);
             corrected_gray = _mm_mul_ps(corrected_gray, v255);
 
-            // Reconverting to 8-bit
-            //__m128i gray8bit = _mm_cvtps_epi32(corrected_gray);
-            //gray8bit = _mm_packus_epi16(gray8bit, gray8bit);
-            //gray8bit = _mm_packus_epi16(gray8bit, gray8bit);
-            
-            __m128i corrected_gray8bit = _mm_cvtps_epi32(corrected_gray);
-
-            // Saving the result
-            //uint32_t temp;
-            //_mm_store_ss((float*)&temp, _mm_castsi128_ps(gray8bit));
-            //result[y * width + x] = (uint8_t)(temp & 0xFF);
-            result[y * width + x] =(uint8_t) _mm_extract_epi32(corrected_gray8bit, 0);
-            result[y * width + x + 1] =(uint8_t) _mm_extract_epi32(corrected_gray8bit, 1);
-            result[y * width + x + 2] =(uint8_t) _mm_extract_epi32(corrected_gray8bit, 2);
-            result[y * width + x + 3] =(uint8_t) _mm_extract_epi32(corrected_gray8bit, 3);
+            // Reconverting to 8-bit with saturation and saving the four results with one store
+            __m128i corrected_gray8bit = _mm_cvttps_epi32(corrected_gray);
+            corrected_gray8bit = _mm_packus_epi16(_mm_packus_epi32(corrected_gray8bit, corrected_gray8bit), corrected_gray8bit);
+            uint32_t packed = (uint32_t)_mm_cvtsi128_si32(corrected_gray8bit);
+            memcpy(out + x, &packed, sizeof(packed));
         }
 
-        if((width % 4) == 0 && restWidth < 6){
-            // Edge cases handling -> when width IS div by 4 but restWidth < 6
-            for (size_t x = restX; x < width; x++) {
-                size_t idx = (y * width + x) * 3;
+        // Edge cases
+        for (; x < width; x++) {
+            const uint8_t* pixel = row + x * 3;
 
-                float R = img[idx];
-                float G = img[idx + 1];
-                float B = img[idx + 2];
+            float R = pixel[0];
+            float G = pixel[1];
+            float B = pixel[2];
 
-                //  Gray scale convertion
-                float gray = (a * R + b * G + c * B) / (a + b + c);
+            //  Gray scale convertion
+            float gray = (a * R + b * G + c * B) / (a + b + c);
 
-                // Gamma correction
-                float gammaCorrectedValue = powf(gray / 255.0f, gamma) * 255.0f;
+            // Gamma correction
+            float gammaCorrectedValue = fast_powf(gray / 255.0f, gamma, precision) * 255.0f;
 
-                result[y * width + x] = (uint8_t)gammaCorrectedValue; 
-            }
+            out[x] = (uint8_t)gammaCorrectedValue;
         }
-        else{
-     // Edge cases
-            for (size_t x = processedWidth; x < width; x++) {
-                size_t idx = (y * width + x) * 3;
-
-                float R = img[idx];
-                float G = img[idx + 1];
-                float B = img[idx + 2];
-
-                //  Gray scale convertion
-                float gray = (a * R + b * G + c * B) / (a + b + c);
-
-                // Gamma correction
-                float gammaCorrectedValue = powf(gray / 255.0f, gamma) * 255.0f;
+    }
+}
 
-                result[y * width + x] = (uint8_t)gammaCorrectedValue;
-            }
-        }
-        
+void gamma_V4(const uint8_t* img, size_t width, size_t height, size_t stride, float a, float b, float c, float gamma, uint8_t* result, size_t result_stride, const struct kernel_tables* tables) {
+    switch (precision) {
+        case POW_LOW:
+            gamma_V4_precision(img, width, height, stride, a, b, c, gamma, result, result_stride, tables->padded, POW_LOW);
+            break;
+        case POW_MEDIUM:
+            gamma_V4_precision(img, width, height, stride, a, b, c, gamma, result, result_stride, tables->padded, POW_MEDIUM);
+            break;
+        default:
+            gamma_V4_precision(img, width, height, stride, a, b, c, gamma, result, result_stride, tables->padded, POW_HIGH);
+            break;
     }
 }
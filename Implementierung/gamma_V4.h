@@ -4,7 +4,14 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <math.h>
+#include "fastpow.h"
 
-void gamma_V4(const uint8_t* img, size_t width, size_t height, float a, float b, float c, float gamma, uint8_t* result);
+struct kernel_tables;
+
+void gamma_V4(const uint8_t* img, size_t width, size_t height, size_t stride, float a, float b, float c, float gamma, uint8_t* result, size_t result_stride, const struct kernel_tables* tables);
+void gamma_V4_avx2(const uint8_t* img, size_t width, size_t height, size_t stride, float a, float b, float c, float gamma, uint8_t* result, size_t result_stride, const struct kernel_tables* tables);
+void gamma_V4_avx512(const uint8_t* img, size_t width, size_t height, size_t stride, float a, float b, float c, float gamma, uint8_t* result, size_t result_stride, const struct kernel_tables* tables);
+void setPowPrecision(enum pow_precision p);
+enum pow_precision getPowPrecision(void);
 
 #endif  // GAMMA_KORREKTUR_SSE_APPROX
\ No newline at end of file
@@ -0,0 +1,107 @@
+#pragma GCC target("avx2")
+#include <immintrin.h>
+#include <stdint.h>
+#include <math.h>
+#include "fastpow.h"
+#include "image.h"
+#include "kernel_tables.h"
+#include "gamma_V4.h"
+
+/*
+ * Applies gamma correction to an image with the algorithm of gamma_V4, using 256-bit AVX2 vectors.
+ *
+ * Parameters:
+ *  - const uint8_t* img: Pointer to the input image data in 8-bit unsigned integer format.
+ *  - size_t width: The width of the image in pixels.
+ *  - size_t height: The height of the image in pixels.
+ *  - size_t stride: Distance between two input rows in bytes, width * 3 without padding.
+ *  - float a, b, c: Coefficients for the weighted sum in grayscale conversion.
+ *  - float gamma: The gamma correction factor.
+ *  - uint8_t* result: Pointer to the memory where the gamma-corrected grayscale image will be stored.
+ *  - size_t result_stride: Distance between two output rows in bytes, width without padding.
+ *  - int padded: Input and output rows have the padding of image_alloc() (kernel_tables.padded).
+ *  - enum pow_precision precision: Tier of the pow approximation (see gamma_V4()).
+ *
+ * Description:
+ * Eight pixels (24 bytes) are processed per iteration. They are loaded with two 16 byte loads at offset 0 and 8, so no
+ * byte behind the eight pixels is touched; the shuffle mask of the upper lane skips the 4 bytes already covered by the
+ * lower one. After the per-lane shuffle each lane holds R, G and B in separate dwords, a cross-lane permute gathers them
+ * into 8 byte groups that are widened to float. An image without gaps between the rows is treated as one row of
+ * width * height pixels, which leaves a single scalar tail of at most seven pixels; a padded image has no tail at all.
+ */
+static inline __attribute__((always_inline)) void gamma_V4_avx2_precision(const uint8_t* img, size_t width, size_t height, size_t stride, float a, float b, float c, float gamma, uint8_t* result, size_t result_stride, int padded, enum pow_precision precision) {
+    __m256 va = _mm256_set1_ps(a);
+    __m256 vb = _mm256_set1_ps(b);
+    __m256 vc = _mm256_set1_ps(c);
+    __m256 vsum = _mm256_set1_ps(a + b + c);
+    __m256 vgamma = _mm256_set1_ps(gamma);
+    __m256 v255 = _mm256_set1_ps(255.0f);
+    __m256 v1_div_255 = _mm256_set1_ps(1.0f / 255.0f);
+
+    // Lower lane: pixels 0..3 at byte 0, upper lane: pixels 4..7 at byte 4 of the second load
+    const __m256i shuffle_mask = _mm256_setr_epi8(0,3,6,9, 1,4,7,10, 2,5,8,11, -1,-1,-1,-1,
+                                                  4,7,10,13, 5,8,11,14, 6,9,12,15, -1,-1,-1,-1);
+    const __m256i gather_rgb = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+    image_flatten(&width, &height, stride, result_stride);
+    for(size_t y = 0; y < height; y++) {
+        const uint8_t* row = img + y * stride;
+        uint8_t* out = result + y * result_stride;
+
+        // With padding the last block reads and writes padding instead of leaving a tail
+        size_t i = 0;
+        for(; padded ? i < width : i + 8 <= width; i += 8) {
+            const uint8_t* src = row + i * 3;
+
+            __m256i rgb = _mm256_set_m128i(_mm_loadu_si128((const __m128i*)(src + 8)), _mm_loadu_si128((const __m128i*)src));
+            rgb = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(rgb, shuffle_mask), gather_rgb);
+
+            // Low 128 bits: R0..R7 G0..G7, high 128 bits: B0..B7
+            __m128i rg = _mm256_castsi256_si128(rgb);
+            __m256 Rf = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(rg));
+            __m256 Gf = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(rg, 8)));
+            __m256 Bf = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm256_extracti128_si256(rgb, 1)));
+
+            // Gray scale convertion
+            __m256 gray = _mm256_div_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(va, Rf), _mm256_mul_ps(vb, Gf)), _mm256_mul_ps(vc, Bf)), vsum);
+
+            // Applying the gammacorrection
+            gray = _mm256_mul_ps(gray, v1_div_255);
+            __m256 corrected_gray = fast_pow_avx2(gray, vgamma, precision);
+            corrected_gray = _mm256_mul_ps(corrected_gray, v255);
+
+            // Reconverting to 8-bit: pack per lane, then move the two 4 byte groups next to each other
+            __m256i gray32 = _mm256_cvttps_epi32(corrected_gray);
+            __m256i gray8 = _mm256_packus_epi16(_mm256_packus_epi32(gray32, gray32), _mm256_setzero_si256());
+            gray8 = _mm256_permutevar8x32_epi32(gray8, gather_rgb);
+            _mm_storel_epi64((__m128i*)(out + i), _mm256_castsi256_si128(gray8));
+        }
+
+        // Edge cases
+        for(; i < width; i++) {
+            const uint8_t* src = row + i * 3;
+
+            //  Gray scale convertion
+            float gray = (a * src[0] + b * src[1] + c * src[2]) / (a + b + c);
+
+            // Gamma correction
+            float gammaCorrectedValue = fast_powf(gray / 255.0f, gamma, precision) * 255.0f;
+
+            out[i] = (uint8_t)gammaCorrectedValue;
+        }
+    }
+}
+
+void gamma_V4_avx2(const uint8_t* img, size_t width, size_t height, size_t stride, float a, float b, float c, float gamma, uint8_t* result, size_t result_stride, const struct kernel_tables* tables) {
+    switch (getPowPrecision()) {
+        case POW_LOW:
+            gamma_V4_avx2_precision(img, width, height, stride, a, b, c, gamma, result, result_stride, tables->padded, POW_LOW);
+            break;
+        case POW_MEDIUM:
+            gamma_V4_avx2_precision(img, width, height, stride, a, b, c, gamma, result, result_stride, tables->padded, POW_MEDIUM);
+            break;
+        default:
+            gamma_V4_avx2_precision(img, width, height, stride, a, b, c, gamma, result, result_stride, tables->padded, POW_HIGH);
+            break;
+    }
+}
@@ -0,0 +1,108 @@
+#pragma GCC target("avx512f,avx512bw")
+#include <immintrin.h>
+#include <stdint.h>
+#include <math.h>
+#include "fastpow.h"
+#include "image.h"
+#include "kernel_tables.h"
+#include "gamma_V4.h"
+
+/*
+ * Applies gamma correction to an image with the algorithm of gamma_V4, using 512-bit AVX-512 vectors.
+ *
+ * Parameters:
+ *  - const uint8_t* img: Pointer to the input image data in 8-bit unsigned integer format.
+ *  - size_t width: The width of the image in pixels.
+ *  - size_t height: The height of the image in pixels.
+ *  - size_t stride: Distance between two input rows in bytes, width * 3 without padding.
+ *  - float a, b, c: Coefficients for the weighted sum in grayscale conversion.
+ *  - float gamma: The gamma correction factor.
+ *  - uint8_t* result: Pointer to the memory where the gamma-corrected grayscale image will be stored.
+ *  - size_t result_stride: Distance between two output rows in bytes, width without padding.
+ *  - int padded: Input and output rows have the padding of image_alloc() (kernel_tables.padded).
+ *  - enum pow_precision precision: Tier of the pow approximation (see gamma_V4()).
+ *
+ * Description:
+ * Sixteen pixels (48 bytes) are processed per iteration. Four 16 byte loads at offset 0, 12, 24 and 32 fill the four
+ * 128-bit lanes; the last load ends exactly at byte 48, its shuffle mask starts at byte 4. After the per-lane shuffle a
+ * dword permute collects all R, G and B bytes in one lane each, and the result is narrowed with a single saturating
+ * vpmovusdb into one 16 byte store. Requires AVX512F and AVX512BW (for the byte shuffle).
+ */
+static inline __attribute__((always_inline)) void gamma_V4_avx512_precision(const uint8_t* img, size_t width, size_t height, size_t stride, float a, float b, float c, float gamma, uint8_t* result, size_t result_stride, int padded, enum pow_precision precision) {
+    __m512 va = _mm512_set1_ps(a);
+    __m512 vb = _mm512_set1_ps(b);
+    __m512 vc = _mm512_set1_ps(c);
+    __m512 vsum = _mm512_set1_ps(a + b + c);
+    __m512 vgamma = _mm512_set1_ps(gamma);
+    __m512 v255 = _mm512_set1_ps(255.0f);
+    __m512 v1_div_255 = _mm512_set1_ps(1.0f / 255.0f);
+
+    const __m512i shuffle_mask = _mm512_set_epi32(
+        -1, 0x0f0c0906, 0x0e0b0805, 0x0d0a0704,     // lane 3 (load at 32): pixels start at byte 4
+        -1, 0x0b080502, 0x0a070401, 0x09060300,
+        -1, 0x0b080502, 0x0a070401, 0x09060300,
+        -1, 0x0b080502, 0x0a070401, 0x09060300);
+    const __m512i gather_rgb = _mm512_setr_epi32(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+
+    image_flatten(&width, &height, stride, result_stride);
+    for(size_t y = 0; y < height; y++) {
+        const uint8_t* row = img + y * stride;
+        uint8_t* out = result + y * result_stride;
+
+        // With padding the last block reads and writes padding instead of leaving a tail
+        size_t i = 0;
+        for(; padded ? i < width : i + 16 <= width; i += 16) {
+            const uint8_t* src = row + i * 3;
+
+            __m512i rgb = _mm512_castsi128_si512(_mm_loadu_si128((const __m128i*)src));
+            rgb = _mm512_inserti32x4(rgb, _mm_loadu_si128((const __m128i*)(src + 12)), 1);
+            rgb = _mm512_inserti32x4(rgb, _mm_loadu_si128((const __m128i*)(src + 24)), 2);
+            rgb = _mm512_inserti32x4(rgb, _mm_loadu_si128((const __m128i*)(src + 32)), 3);
+            rgb = _mm512_permutexvar_epi32(gather_rgb, _mm512_shuffle_epi8(rgb, shuffle_mask));
+
+            // Lane 0: R0..R15, lane 1: G0..G15, lane 2: B0..B15
+            __m512 Rf = _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(_mm512_castsi512_si128(rgb)));
+            __m512 Gf = _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(_mm512_extracti32x4_epi32(rgb, 1)));
+            __m512 Bf = _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(_mm512_extracti32x4_epi32(rgb, 2)));
+
+            // Gray scale convertion
+            __m512 gray = _mm512_div_ps(_mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(va, Rf), _mm512_mul_ps(vb, Gf)), _mm512_mul_ps(vc, Bf)), vsum);
+
+            // Applying the gammacorrection
+            gray = _mm512_mul_ps(gray, v1_div_255);
+            __m512 corrected_gray = fast_pow_avx512(gray, vgamma, precision);
+            corrected_gray = _mm512_mul_ps(corrected_gray, v255);
+
+            // Reconverting to 8-bit with unsigned saturation
+            __m512i gray32 = _mm512_max_epi32(_mm512_cvttps_epi32(corrected_gray), _mm512_setzero_si512());
+            _mm_storeu_si128((__m128i*)(out + i), _mm512_cvtusepi32_epi8(gray32));
+        }
+
+        // Edge cases
+        for(; i < width; i++) {
+            const uint8_t* src = row + i * 3;
+
+            //  Gray scale convertion
+            float gray = (a * src[0] + b * src[1] + c * src[2]) / (a + b + c);
+
+            // Gamma correction
+            float gammaCorrectedValue = fast_powf(gray / 255.0f, gamma, precision) * 255.0f;
+
+            out[i] = (uint8_t)gammaCorrectedValue;
+        }
+    }
+}
+
+void gamma_V4_avx512(const uint8_t* img, size_t width, size_t height, size_t stride, float a, float b, float c, float gamma, uint8_t* result, size_t result_stride, const struct kernel_tables* tables) {
+    switch (getPowPrecision()) {
+        case POW_LOW:
+            gamma_V4_avx512_precision(img, width, height, stride, a, b, c, gamma, result, result_stride, tables->padded, POW_LOW);
+            break;
+        case POW_MEDIUM:
+            gamma_V4_avx512_precision(img, width, height, stride, a, b, c, gamma, result, result_stride, tables->padded, POW_MEDIUM);
+            break;
+        default:
+            gamma_V4_avx512_precision(img, width, height, stride, a, b, c, gamma, result, result_stride, tables->padded, POW_HIGH);
+            break;
+    }
+}
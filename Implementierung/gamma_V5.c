@@ -0,0 +1,72 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+#include "image.h"
+#include "kernel_tables.h"
+#include "gamma_V5.h"
+
+/*
+ * Fills a lookup table with the gamma corrected value of every gray level.
+ *
+ * Parameters:
+ *  - float gamma: The gamma correction factor.
+ *  - size_t steps: Number of table entries per gray level (1 gives the classic 256 entry table).
+ *  - uint8_t* table: Pointer to a table with room for 255 * steps + 1 entries.
+ *
+ * Description:
+ * Entry i holds powf(i / steps / 255, gamma) * 255 truncated to 8 bit, i.e. exactly what gamma_V0 computes for the
+ * gray value i / steps. With steps > 1 the fractional part of the weighted sum is kept, so a lookup with the truncated
+ * index differs from gamma_V0 by at most one gray level.
+ */
+void buildGammaTable(float gamma, size_t steps, uint8_t* table){
+    size_t entries = 255 * steps + 1;
+    for(size_t i = 0; i < entries; i++){
+        float d = (float)i / (float)steps;
+        float result_1 = powf(d / 255.0f, gamma) * 255.0f;
+        table[i] = (uint8_t)fminf(fmaxf(result_1, 0), 255);
+    }
+}
+
+/*
+ * Applies gamma correction to an image using a precomputed lookup table.
+ *
+ * Parameters:
+ *  - const uint8_t* img: Pointer to the input image data in 8-bit unsigned integer format.
+ *  - size_t width: The width of the image in pixels.
+ *  - size_t height: The height of the image in pixels.
+ *  - size_t stride: Distance between two input rows in bytes, width * 3 without padding.
+ *  - float a, b, c: Coefficients for the weighted sum in grayscale conversion.
+ *  - float gamma: The gamma correction factor.
+ *  - uint8_t* result: Pointer to the memory where the gamma-corrected grayscale image will be stored.
+ *  - size_t result_stride: Distance between two output rows in bytes, width without padding.
+ *  - const struct kernel_tables* tables: tables->fine, buildGammaTable() with GAMMA_V5_STEPS and the --ops fused in.
+ *
+ * Description:
+ * The output has only 256 possible values, so the transcendental part of the algorithm is evaluated once per plan for
+ * GAMMA_V5_TABLE_SIZE gray levels instead of once per pixel. The coefficients are normalised and pre-scaled by
+ * GAMMA_V5_STEPS, which removes the division by (a + b + c): the per-pixel work is one weighted sum and one table lookup.
+ */
+void gamma_V5(const uint8_t* img, size_t width, size_t height, size_t stride, float a, float b, float c, float gamma, uint8_t* result, size_t result_stride, const struct kernel_tables* tables){
+    (void)gamma;
+    const uint8_t* table = tables->fine;
+    float sum = a + b + c;
+    float scale = sum > 0 ? (float)GAMMA_V5_STEPS / sum : 0;
+    float wa = a * scale;
+    float wb = b * scale;
+    float wc = c * scale;
+    float maxIndex = GAMMA_V5_TABLE_SIZE - 1;
+
+    image_flatten(&width, &height, stride, result_stride);
+    for(size_t y = 0; y < height; y++){
+        const uint8_t* row = img + y * stride;
+        uint8_t* out = result + y * result_stride;
+        for(size_t i = 0; i < width; i++){
+            const uint8_t* pixel = row + i * 3;
+
+            // weighted sum already scaled to the table index
+            float d = wa * pixel[0] + wb * pixel[1] + wc * pixel[2];
+
+            out[i] = table[(size_t)fminf(d, maxIndex)];
+        }
+    }
+}
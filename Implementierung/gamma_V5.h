@@ -0,0 +1,17 @@
+#ifndef GAMMA_V5_H
+#define GAMMA_V5_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+
+struct kernel_tables;
+
+// Number of table entries per gray level; the fine table has 255 * GAMMA_V5_STEPS + 1 entries
+#define GAMMA_V5_STEPS 16
+#define GAMMA_V5_TABLE_SIZE (255 * GAMMA_V5_STEPS + 1)
+
+void buildGammaTable(float gamma, size_t steps, uint8_t* table);
+void gamma_V5(const uint8_t* img, size_t width, size_t height, size_t stride, float a, float b, float c, float gamma, uint8_t* result, size_t result_stride, const struct kernel_tables* tables);
+
+#endif  // GAMMA_KORREKTUR_LUT
@@ -0,0 +1,18 @@
+#ifndef GAMMA_V6_H
+#define GAMMA_V6_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+
+struct kernel_tables;
+
+// Fractional bits of the fixed-point grayscale weights (weights sum to 1 << GAMMA_V6_SHIFT)
+#define GAMMA_V6_SHIFT 14
+
+void fixedPointWeights(float a, float b, float c, int16_t* weights);
+uint8_t grayFixed(const uint8_t* pixel, const int16_t* weights);
+void grayTableFixed(const uint8_t* img, size_t width, size_t height, size_t stride, float a, float b, float c, const uint8_t* table, uint8_t* result, size_t result_stride, int padded);
+void gamma_V6(const uint8_t* img, size_t width, size_t height, size_t stride, float a, float b, float c, float gamma, uint8_t* result, size_t result_stride, const struct kernel_tables* tables);
+
+#endif  // GAMMA_KORREKTUR_FIXED
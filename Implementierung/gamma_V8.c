@@ -0,0 +1,137 @@
+#pragma GCC target("sse4.1")
+#include <emmintrin.h>
+#include <smmintrin.h>
+#include <stdint.h>
+#include "fastpow.h"
+#include "image.h"
+#include "kernel_tables.h"
+#include "gamma_V4.h"
+#include "gamma_V8.h"
+
+/*
+ * Byte selection of the deinterleaving. In 48 bytes of RGB data the bytes of one channel lie at positions that are
+ * pairwise different modulo 16 (R: 0, 3, ... 15 from the first load, 18 ... 30 from the second, 33 ... 45 from the third).
+ * Two blends therefore collect all 16 bytes of a channel in one register, and one pshufb puts them into pixel order.
+ */
+#define TAKE -128                                   // blend mask byte: take the byte from the later load
+
+/*
+ * Gray value and gamma correction of 16 pixels.
+ *
+ * Parameters:
+ *  - const uint8_t* src: 48 bytes of RGB data.
+ *  - __m128 va, vb, vc, vsum, vgamma: Coefficients, their sum and gamma in all four lanes.
+ *  - enum pow_precision precision: Tier of fast_pow_sse().
+ *
+ * Returns:
+ *  - __m128i: The 16 gray values, saturated to 8 bit.
+ *
+ * Description:
+ * The three channels are separated with 6 blends and 3 byte shuffles (see above), then widened in groups of four to
+ * float. The arithmetic is the one of gamma_V4, so both versions give the same result.
+ */
+static inline __attribute__((always_inline)) __m128i gamma_block16(const uint8_t* src, __m128 va, __m128 vb, __m128 vc, __m128 vsum, __m128 vgamma, enum pow_precision precision){
+    // Position of a byte in the blended register: bytes i with i % 3 == channel come from load 0,
+    // (i + 16) % 3 == channel from load 1 and (i + 32) % 3 == channel from load 2
+    const __m128i select_b_r = _mm_setr_epi8(0,0,TAKE,0,0,TAKE,0,0,TAKE,0,0,TAKE,0,0,TAKE,0);
+    const __m128i select_c_r = _mm_setr_epi8(0,TAKE,0,0,TAKE,0,0,TAKE,0,0,TAKE,0,0,TAKE,0,0);
+    const __m128i select_b_g = _mm_setr_epi8(TAKE,0,0,TAKE,0,0,TAKE,0,0,TAKE,0,0,TAKE,0,0,TAKE);
+    const __m128i select_c_g = _mm_setr_epi8(0,0,TAKE,0,0,TAKE,0,0,TAKE,0,0,TAKE,0,0,TAKE,0);
+    const __m128i select_b_b = _mm_setr_epi8(0,TAKE,0,0,TAKE,0,0,TAKE,0,0,TAKE,0,0,TAKE,0,0);
+    const __m128i select_c_b = _mm_setr_epi8(TAKE,0,0,TAKE,0,0,TAKE,0,0,TAKE,0,0,TAKE,0,0,TAKE);
+    // pixel order: R of pixel k sits at byte 3k % 16, G at (3k + 1) % 16, B at (3k + 2) % 16
+    const __m128i order_r = _mm_setr_epi8(0,3,6,9,12,15,2,5,8,11,14,1,4,7,10,13);
+    const __m128i order_g = _mm_setr_epi8(1,4,7,10,13,0,3,6,9,12,15,2,5,8,11,14);
+    const __m128i order_b = _mm_setr_epi8(2,5,8,11,14,1,4,7,10,13,0,3,6,9,12,15);
+
+    __m128i p0 = _mm_loadu_si128((const __m128i*)src);
+    __m128i p1 = _mm_loadu_si128((const __m128i*)(src + 16));
+    __m128i p2 = _mm_loadu_si128((const __m128i*)(src + 32));
+
+    __m128i R = _mm_shuffle_epi8(_mm_blendv_epi8(_mm_blendv_epi8(p0, p1, select_b_r), p2, select_c_r), order_r);
+    __m128i G = _mm_shuffle_epi8(_mm_blendv_epi8(_mm_blendv_epi8(p0, p1, select_b_g), p2, select_c_g), order_g);
+    __m128i B = _mm_shuffle_epi8(_mm_blendv_epi8(_mm_blendv_epi8(p0, p1, select_b_b), p2, select_c_b), order_b);
+
+    __m128i gray32[4];
+    for (int k = 0; k < 4; k++) {
+        __m128 Rf = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(R));
+        __m128 Gf = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(G));
+        __m128 Bf = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(B));
+        R = _mm_srli_si128(R, 4);
+        G = _mm_srli_si128(G, 4);
+        B = _mm_srli_si128(B, 4);
+
+        // Gray scale convertion and gamma correction as in gamma_V4
+        __m128 gray = _mm_div_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(va, Rf), _mm_mul_ps(vb, Gf)), _mm_mul_ps(vc, Bf)), vsum);
+        gray = _mm_mul_ps(gray, _mm_set1_ps(1.0f / 255.0f));
+        __m128 corrected = _mm_mul_ps(fast_pow_sse(gray, vgamma, precision), _mm_set1_ps(255.0f));
+        gray32[k] = _mm_cvttps_epi32(corrected);
+    }
+    return _mm_packus_epi16(_mm_packus_epi32(gray32[0], gray32[1]), _mm_packus_epi32(gray32[2], gray32[3]));
+}
+
+/*
+ * Applies gamma correction to an image with SSE4.1, sixteen pixels per iteration.
+ *
+ * Parameters:
+ *  - const uint8_t* img: Pointer to the input image data in 8-bit unsigned integer format.
+ *  - size_t width: The width of the image in pixels.
+ *  - size_t height: The height of the image in pixels.
+ *  - size_t stride: Distance between two input rows in bytes, width * 3 without padding.
+ *  - float a, b, c: Coefficients for the weighted sum in grayscale conversion.
+ *  - float gamma: The gamma correction factor.
+ *  - uint8_t* result: Pointer to the memory where the gamma-corrected grayscale image will be stored.
+ *  - size_t result_stride: Distance between two output rows in bytes, width without padding.
+ *  - int padded: Input and output rows have the padding of image_alloc() (kernel_tables.padded).
+ *  - enum pow_precision precision: Tier of the pow approximation (see gamma_V4()).
+ *
+ * Description:
+ * Every iteration reads exactly the 48 bytes of 16 pixels with three loads, so unlike gamma_V3/gamma_V4 no byte is
+ * loaded twice and no load reaches behind the pixels. The 16 results are packed with packus and written with a single
+ * 16 byte store instead of four extracts per four pixels. The last block of a row (or of the whole image if the rows
+ * have no gaps) is moved back so it ends at the last pixel; the overlapping pixels are computed twice with the same
+ * result. Only rows narrower than 16 pixels use the scalar fast_powf(), and padded images run into their padding.
+ */
+static inline __attribute__((always_inline)) void gamma_V8_precision(const uint8_t* img, size_t width, size_t height, size_t stride, float a, float b, float c, float gamma, uint8_t* result, size_t result_stride, int padded, enum pow_precision precision) {
+    __m128 va = _mm_set1_ps(a);
+    __m128 vb = _mm_set1_ps(b);
+    __m128 vc = _mm_set1_ps(c);
+    __m128 vsum = _mm_set1_ps(a + b + c);
+    __m128 vgamma = _mm_set1_ps(gamma);
+
+    image_flatten(&width, &height, stride, result_stride);
+    for (size_t y = 0; y < height; y++) {
+        const uint8_t* row = img + y * stride;
+        uint8_t* out = result + y * result_stride;
+
+        size_t i = 0;
+        for (; padded ? i < width : i + 16 <= width; i += 16) {
+            _mm_storeu_si128((__m128i*)(out + i), gamma_block16(row + i * 3, va, vb, vc, vsum, vgamma, precision));
+        }
+        if (i < width && width >= 16) {
+            // Overlapping last block instead of a scalar tail
+            i = width - 16;
+            _mm_storeu_si128((__m128i*)(out + i), gamma_block16(row + i * 3, va, vb, vc, vsum, vgamma, precision));
+            i = width;
+        }
+        for (; i < width; i++) {
+            const uint8_t* pixel = row + i * 3;
+            float gray = (a * pixel[0] + b * pixel[1] + c * pixel[2]) / (a + b + c);
+            out[i] = (uint8_t)(fast_powf(gray * (1.0f / 255.0f), gamma, precision) * 255.0f);
+        }
+    }
+}
+
+void gamma_V8(const uint8_t* img, size_t width, size_t height, size_t stride, float a, float b, float c, float gamma, uint8_t* result, size_t result_stride, const struct kernel_tables* tables) {
+    switch (getPowPrecision()) {
+        case POW_LOW:
+            gamma_V8_precision(img, width, height, stride, a, b, c, gamma, result, result_stride, tables->padded, POW_LOW);
+            break;
+        case POW_MEDIUM:
+            gamma_V8_precision(img, width, height, stride, a, b, c, gamma, result, result_stride, tables->padded, POW_MEDIUM);
+            break;
+        default:
+            gamma_V8_precision(img, width, height, stride, a, b, c, gamma, result, result_stride, tables->padded, POW_HIGH);
+            break;
+    }
+}
@@ -0,0 +1,11 @@
+#ifndef GAMMA_V8_H
+#define GAMMA_V8_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+struct kernel_tables;
+
+void gamma_V8(const uint8_t* img, size_t width, size_t height, size_t stride, float a, float b, float c, float gamma, uint8_t* result, size_t result_stride, const struct kernel_tables* tables);
+
+#endif  // GAMMA_V8_H
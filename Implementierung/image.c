@@ -0,0 +1,91 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <emmintrin.h>
+#include "image.h"
+#include "bufpool.h"
+
+// Bytes per row of a padded image: the pixels plus at least IMAGE_ALIGN bytes, rounded up to a multiple of IMAGE_ALIGN
+size_t image_stride(size_t width, size_t channels){
+    return (width * channels + 2 * IMAGE_ALIGN - 1) / IMAGE_ALIGN * IMAGE_ALIGN;
+}
+
+/*
+ * Allocates a padded image.
+ *
+ * Parameters:
+ *  - size_t width, height: Size of the image in pixels.
+ *  - size_t channels: Bytes per pixel, 3 for P6 and 1 for P5 images.
+ *  - size_t* stride: Receives the distance between two rows in bytes.
+ *
+ * Returns:
+ *  - uint8_t*: The pixels, released with image_free(), or NULL if the allocation failed.
+ *
+ * Description:
+ * Every row starts at a multiple of IMAGE_ALIGN and is followed by at least IMAGE_ALIGN bytes of padding. A kernel whose
+ * input and output both come from here (see plan_set_padded()) runs whole vectors up to the end of every row: the loads
+ * of the last vector read padding and the stores write padding, so there is no scalar remainder. The padding is zeroed
+ * once so the values read there are always defined. The buffer comes from bufpool_get(), so an image of the same size released
+ * before is reused without new pages.
+ */
+uint8_t* image_alloc(size_t width, size_t height, size_t channels, size_t* stride){
+    *stride = image_stride(width, channels);
+    uint8_t* pixels = bufpool_get(*stride * (height > 0 ? height : 1));
+    if (!pixels) {
+        return NULL;
+    }
+    for (size_t y = 0; y < height; y++) {
+        memset(pixels + y * *stride + width * channels, 0, *stride - width * channels);
+    }
+    return pixels;
+}
+
+// Releases an image of image_alloc() for reuse
+void image_free(uint8_t* pixels){
+    bufpool_put(pixels);
+}
+
+/*
+ * Swaps the two bytes of every 16 bit sample in place, converting between the big endian samples of a PPM/PGM file
+ * and the host byte order. Eight samples are swapped at once with two shifts and an or; samples may be unaligned.
+ */
+void image_swap16(uint8_t* samples, size_t count){
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128((__m128i*)(samples + i * 2));
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        _mm_storeu_si128((__m128i*)(samples + i * 2), v);
+    }
+    for (; i < count; i++) {
+        uint8_t t = samples[i * 2];
+        samples[i * 2] = samples[i * 2 + 1];
+        samples[i * 2 + 1] = t;
+    }
+}
+
+// Checks if every sample is smaller or the same as the max value given, returns 0 if one exceeds it
+int check_max_val(const uint8_t* samples, size_t count, int max_val) {
+    if (max_val >= 255) {
+        return 1;                   // every byte is valid, no need to look at the samples
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (samples[i] > max_val) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Same check for 16 bit samples
+int check_max_val16(const uint16_t* samples, size_t count, int max_val) {
+    if (max_val >= 65535) {
+        return 1;
+    }
+    uint16_t max = (uint16_t)max_val;
+    int exceeded = 0;
+    for (size_t i = 0; i < count; i++) {
+        exceeded |= samples[i] > max;        // no early exit, so the loop is vectorised
+    }
+    return !exceeded;
+}
@@ -0,0 +1,34 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+// Alignment of every row of a padded image and the minimum number of bytes behind the last pixel of a row that
+// the kernels may read and write
+#define IMAGE_ALIGN 64
+
+size_t image_stride(size_t width, size_t channels);
+uint8_t* image_alloc(size_t width, size_t height, size_t channels, size_t* stride);
+void image_free(uint8_t* pixels);
+void image_swap16(uint8_t* samples, size_t count);
+int check_max_val(const uint8_t* samples, size_t count, int max_val);
+int check_max_val16(const uint16_t* samples, size_t count, int max_val);
+
+// Treats an image without gaps between the rows as one row of width * height pixels, so a kernel has a single tail
+static inline void image_flatten(size_t* width, size_t* height, size_t stride, size_t result_stride){
+    if (stride == *width * 3 && result_stride == *width) {
+        *width *= *height;
+        *height = *height > 0 ? 1 : 0;
+    }
+}
+
+// image_flatten() for 16 bit samples, the strides are in bytes as well
+static inline void image_flatten16(size_t* width, size_t* height, size_t stride, size_t result_stride){
+    if (stride == *width * 6 && result_stride == *width * 2) {
+        *width *= *height;
+        *height = *height > 0 ? 1 : 0;
+    }
+}
+
+#endif  // IMAGE_H
@@ -0,0 +1,127 @@
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "ingest.h"
+#include "bufpool.h"
+
+// Parses the header with the stdio reader and keeps a descriptor for the parallel reads of the pixel data
+void ingest_open(const char* filename, P6Ingest* ingest) {
+    FILE* file = fopen(filename, "rb");
+    if (!file) {
+        perror("Error opening file");
+        exit(EXIT_FAILURE);
+    }
+    read_p6_header(file, &ingest->width, &ingest->height, &ingest->max_val);
+    require_8bit(ingest->max_val, "with --pread and --async");
+    ingest->offset = (size_t)ftell(file);
+    fclose(file);
+
+    ingest->fd = open(filename, O_RDONLY);
+    if (ingest->fd < 0) {
+        perror("Error opening file");
+        exit(EXIT_FAILURE);
+    }
+    posix_fadvise(ingest->fd, (off_t)ingest->offset, 0, POSIX_FADV_SEQUENTIAL);
+}
+
+// State of one ingest_read() call shared by all chunks
+struct chunk_job {
+    P6Ingest* ingest;
+    uint8_t* pixels;
+    size_t rows_per_chunk;
+    ingest_callback callback;
+    void* ctx;
+    atomic_int error;       // first error seen by any chunk, reported after all threads are done
+};
+
+static void read_chunk(void* arg, size_t index) {
+    struct chunk_job* job = arg;
+    P6Ingest* ingest = job->ingest;
+    size_t row_bytes = ingest->width * 3;
+    size_t first_row = index * job->rows_per_chunk;
+    size_t rows = ingest->height - first_row < job->rows_per_chunk ? ingest->height - first_row : job->rows_per_chunk;
+
+    uint8_t* dst = job->pixels + first_row * row_bytes;
+    size_t bytes = rows * row_bytes;
+    off_t position = (off_t)(ingest->offset + first_row * row_bytes);
+
+    // pread may return less than requested, continue until the chunk is complete
+    size_t done = 0;
+    while (done < bytes) {
+        ssize_t n = pread(ingest->fd, dst + done, bytes - done, position + (off_t)done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            int expected = 0;
+            atomic_compare_exchange_strong(&job->error, &expected, n < 0 ? errno : EIO);
+            return;
+        }
+        done += (size_t)n;
+    }
+
+    if (!check_max_val(dst, bytes, ingest->max_val)) {
+        int expected = 0;
+        atomic_compare_exchange_strong(&job->error, &expected, ERANGE);
+        return;
+    }
+    if (job->callback) {
+        job->callback(job->ctx, dst, first_row, rows);
+    }
+}
+
+/*
+ * Reads the pixel data of an opened P6 file with parallel preads.
+ *
+ * Parameters:
+ *  - P6Ingest* ingest: File opened with ingest_open(), the descriptor is closed before returning.
+ *  - thread_pool* pool: Threads issuing the reads; NULL reads all chunks on the calling thread.
+ *  - ingest_callback callback: Optional function called for every chunk right after it was read and validated.
+ *  - void* ctx: Passed to the callback.
+ *
+ * Returns:
+ *  - PPMImage: The image in a buffer of bufpool_get(), to be released with free_p6().
+ *
+ * Description:
+ * The pixel data is split into chunks of whole rows of about INGEST_CHUNK_BYTES. Every thread reads a chunk with
+ * pread at its own offset, so several requests are in flight at once and the device queue stays filled, checks it
+ * against the max value and hands it to the callback while other chunks are still being read. This way a kernel can
+ * process the first rows before the end of the file has arrived.
+ */
+PPMImage ingest_read(P6Ingest* ingest, thread_pool* pool, ingest_callback callback, void* ctx) {
+    PPMImage ppmImage = {0};
+    ppmImage.width = ingest->width;
+    ppmImage.height = ingest->height;
+    ppmImage.stride = ingest->width * 3;
+    ppmImage.image = bufpool_get(ingest->width * ingest->height * 3);
+    if (!ppmImage.image) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    struct chunk_job job = {ingest, ppmImage.image, INGEST_CHUNK_BYTES / (ingest->width * 3), callback, ctx, 0};
+    atomic_init(&job.error, 0);
+    if (job.rows_per_chunk == 0) {
+        job.rows_per_chunk = 1;
+    }
+    size_t chunks = (ingest->height + job.rows_per_chunk - 1) / job.rows_per_chunk;
+    threadpool_for(pool, read_chunk, &job, chunks);
+    close(ingest->fd);
+
+    int error = atomic_load(&job.error);
+    if (error == ERANGE) {
+        fprintf(stderr, "Error: Pixel value exceeds the maximum value of %d\n", ingest->max_val);
+        exit(EXIT_FAILURE);
+    }
+    if (error) {
+        fprintf(stderr, "Error reading from file: %s\n", strerror(error));
+        exit(EXIT_FAILURE);
+    }
+    return ppmImage;
+}
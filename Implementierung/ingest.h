@@ -0,0 +1,26 @@
+#ifndef INGEST_H
+#define INGEST_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "read.h"
+#include "threadpool.h"
+
+// Approximate size of one pread chunk, rounded to whole rows
+#define INGEST_CHUNK_BYTES (4u << 20)
+
+// Called from a reader thread as soon as rows [first_row, first_row + rows) are in memory and validated
+typedef void (*ingest_callback)(void* ctx, const uint8_t* pixels, size_t first_row, size_t rows);
+
+typedef struct {
+    int fd;
+    size_t width;
+    size_t height;
+    int max_val;
+    size_t offset;       // file offset of the first pixel byte
+} P6Ingest;
+
+void ingest_open(const char* filename, P6Ingest* ingest);
+PPMImage ingest_read(P6Ingest* ingest, thread_pool* pool, ingest_callback callback, void* ctx);
+
+#endif  // INGEST_H
@@ -0,0 +1,23 @@
+#ifndef KERNEL_TABLES_H
+#define KERNEL_TABLES_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "gamma_V5.h"
+
+/*
+ * Lookup tables of a kernel plan (see plan_kernel()). They are built once for a context, a stream or a batch and then
+ * only read, by every thread and for every image, so no kernel builds a table of its own per call or per band. The
+ * operations of --ops are fused into every table: a kernel that looks its result up in one of them applies the whole
+ * chain with the same lookup.
+ */
+struct kernel_tables {
+    uint8_t gamma[256];                    // result of every gray value (versions 6, 7 and the color kernels)
+    uint8_t fine[GAMMA_V5_TABLE_SIZE];     // result of every 1 / GAMMA_V5_STEPS gray level (version 5)
+    uint8_t ops[256];                      // the operations alone, run over the output of kernels without a table
+    int max_val;                           // max value of 16 bit samples
+    uint16_t* gamma16;                     // max_val + 1 results of gamma16_table, NULL for the other kernels
+    int padded;                            // input and result rows have the padding of image_alloc(), see plan_set_padded()
+};
+
+#endif  // KERNEL_TABLES_H
@@ -0,0 +1,426 @@
+#define _POSIX_C_SOURCE 199309L
+#include <cpuid.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "gamma_V0.h"
+#include "gamma_V1.h"
+#include "gamma_V2.h"
+#include "gamma_V3.h"
+#include "gamma_V4.h"
+#include "gamma_V5.h"
+#include "gamma_V6.h"
+#include "gamma_V8.h"
+#include "pipeline.h"
+#include "gamma16.h"
+#include "color.h"
+#include "libgamma.h"
+#include "kernels.h"
+
+/*
+ * Registry of all implementations.
+ *
+ * A version may have several entries for different instruction sets; the widest one the CPU (and --isa) allows is
+ * used. The accuracy classes follow the --compare report over benchmark_img with the default --precision, see
+ * kernel_accuracy() for the other tiers. Versions without a 16 bit variant run the
+ * 16 bit reference gamma16_V0 on 16 bit images.
+ */
+const struct kernel_desc kernel_registry[] = {
+    {0, "powf",                 gamma_V0,        ISA_SCALAR, ACCURACY_EXACT,  gamma16_V0,    TABLE_NONE,  0},
+    {1, "interpolated power",   gamma_V1,        ISA_SCALAR, ACCURACY_LOW,    NULL,          TABLE_NONE,  0},
+    {2, "exp/log two-pass",     gamma_V2,        ISA_SCALAR, ACCURACY_MEDIUM, NULL,          TABLE_NONE,  0},
+    {3, "SSE gray + powf",      gamma_V3,        ISA_SSE41,  ACCURACY_EXACT,  NULL,          TABLE_NONE,  0},
+    {4, "SSE fast pow",         gamma_V4,        ISA_SSE41,  ACCURACY_HIGH,   gamma16_V4,    TABLE_NONE,  1},
+    {4, "AVX2 fast pow",        gamma_V4_avx2,   ISA_AVX2,   ACCURACY_HIGH,   gamma16_V4,    TABLE_NONE,  1},
+    {4, "AVX-512 fast pow",     gamma_V4_avx512, ISA_AVX512, ACCURACY_HIGH,   gamma16_V4,    TABLE_NONE,  1},
+    {5, "lookup table",         gamma_V5,        ISA_SCALAR, ACCURACY_HIGH,   gamma16_table, TABLE_FINE,  0},
+    {6, "fixed-point + table",  gamma_V6,        ISA_SSE41,  ACCURACY_MEDIUM, gamma16_table, TABLE_GAMMA, 0},
+    {7, "tiled table two-pass", gamma_V2_tiled,  ISA_SCALAR, ACCURACY_MEDIUM, NULL,          TABLE_GAMMA, 0},
+    {8, "SSE 16 pixels",        gamma_V8,        ISA_SSE41,  ACCURACY_HIGH,   gamma16_V4,    TABLE_NONE,  1},
+};
+const size_t kernel_registry_size = sizeof(kernel_registry) / sizeof(kernel_registry[0]);
+
+static const char* accuracy_names[] = {
+    [ACCURACY_EXACT] = "exact",
+    [ACCURACY_HIGH] = "high",
+    [ACCURACY_MEDIUM] = "medium",
+    [ACCURACY_LOW] = "low",
+};
+
+// Accuracy class of a kernel with the current --precision. The low tier of fastpow.h is only meant for 8 bit output and
+// gamma <= 2: it still stays within a gray level of gamma_V0 there, but matches it for only about 94% of the pixels
+// instead of 99.8%, and 16 bit results are off by up to 0.1% of the max value. Its kernels are medium then.
+enum accuracy_class kernel_accuracy(const struct kernel_desc* kernel){
+    if (kernel->fast_pow && getPowPrecision() == POW_LOW && kernel->accuracy < ACCURACY_MEDIUM) {
+        return ACCURACY_MEDIUM;
+    }
+    return kernel->accuracy;
+}
+
+const char* accuracy_name(enum accuracy_class accuracy){
+    return accuracy_names[accuracy];
+}
+
+// Converts an --accuracy argument, returns 0 if the name is unknown
+int parse_accuracy(const char* name, enum accuracy_class* accuracy){
+    for (size_t i = 0; i < sizeof(accuracy_names) / sizeof(accuracy_names[0]); i++) {
+        if (strcmp(name, accuracy_names[i]) == 0) {
+            *accuracy = (enum accuracy_class)i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Returns the entry of a version with the widest instruction set available, or NULL if none of them can run here
+const struct kernel_desc* find_kernel(int version){
+    const struct kernel_desc* best = NULL;
+    enum isa_level isa = cpu_active_isa();
+    for (size_t i = 0; i < kernel_registry_size; i++) {
+        const struct kernel_desc* k = &kernel_registry[i];
+        if (k->version == version && k->isa <= isa && (!best || k->isa > best->isa)) {
+            best = k;
+        }
+    }
+    return best;
+}
+
+// Returns the implementation belonging to a version number for the samples of a plan and the table it reads, or NULL if
+// there is none. Versions whose instruction set is missing fall back to the scalar reference gamma_V0; in color mode
+// every version runs the color kernel, there is one per instruction set.
+static gamma_kernel select_kernel(const struct kernel_plan* plan, int version, enum kernel_table* table){
+    *table = TABLE_NONE;
+    if (version < 0 || version >= NUM_VERSIONS) {
+        return NULL;
+    }
+    if (plan->color) {
+        *table = TABLE_GAMMA;
+        return select_color_kernel();
+    }
+    const struct kernel_desc* k = find_kernel(version);
+    if (plan->max_val > 255) {
+        gamma_kernel kernel = k && k->kernel16 ? k->kernel16 : gamma16_V0;
+        *table = kernel == gamma16_table ? TABLE_GAMMA16 : TABLE_NONE;
+        return kernel;
+    }
+    if (!k) {
+        return gamma_V0;
+    }
+    *table = k->table;
+    return k->kernel;
+}
+
+// Fills the table the kernel of the plan reads, with the operations fused in
+static void build_tables(struct kernel_plan* plan){
+    struct kernel_tables* tables = &plan->tables;
+    if (plan->ops.count > 0) {
+        for (int v = 0; v < 256; v++) {
+            tables->ops[v] = (uint8_t)v;
+        }
+        pipeline_fuse(&plan->ops, tables->ops);
+    }
+    if (plan->table == TABLE_GAMMA) {
+        buildGammaTable(plan->gamma, 1, tables->gamma);
+        pipeline_fuse(&plan->ops, tables->gamma);
+    } else if (plan->table == TABLE_FINE) {
+        buildGammaTable(plan->gamma, GAMMA_V5_STEPS, tables->fine);
+        for (size_t i = 0; plan->ops.count > 0 && i < GAMMA_V5_TABLE_SIZE; i++) {
+            tables->fine[i] = tables->ops[tables->fine[i]];
+        }
+    } else if (plan->table == TABLE_GAMMA16) {
+        buildGammaTable16(plan->gamma, tables->max_val, tables->gamma16);
+    }
+}
+
+// Sets the parameters of a plan, ops may be NULL for none; plan_kernel() has to choose the kernel before plan_run().
+// max_val is the one of the images: up to 255 they have 8 bit samples, above 16 bit samples scaled with it.
+void plan_init(struct kernel_plan* plan, float a, float b, float c, float gamma, int max_val, int color, const struct point_pipeline* ops){
+    plan->kernel = NULL;
+    plan->a = a;
+    plan->b = b;
+    plan->c = c;
+    plan->gamma = gamma;
+    plan->max_val = max_val;
+    plan->color = color;
+    if (ops) {
+        plan->ops = *ops;
+    } else {
+        pipeline_init(&plan->ops);
+    }
+    plan->table = TABLE_NONE;
+    plan->post = 0;
+    plan->tables.max_val = max_val > 255 ? max_val : 255;
+    plan->tables.gamma16 = NULL;
+    plan->tables.padded = 0;
+}
+
+/*
+ * Chooses the kernel of a version for the samples and mode of the plan and builds the tables it reads.
+ *
+ * Returns:
+ *  - int: GAMMA_OK, GAMMA_ERROR_VERSION if there is no such version, GAMMA_ERROR_ARGUMENT for operations or color mode
+ *    with 16 bit samples (they map 8 bit values), GAMMA_ERROR_MEMORY if the 16 bit table can't be allocated. The plan is
+ *    unchanged on errors.
+ *
+ * Description:
+ * The operations are fused into the gamma table of the kernels that look their result up (versions 5, 6, 7 and
+ * the color kernels), so they cost nothing there; the other kernels get a pass with the operations table over the
+ * output of every band while it is still in the cache. The table of gamma16_table has max value + 1 entries and is
+ * allocated here, it is released by plan_free().
+ */
+int plan_kernel(struct kernel_plan* plan, int version){
+    if ((plan->ops.count > 0 || plan->color) && plan->max_val > 255) {
+        return GAMMA_ERROR_ARGUMENT;
+    }
+    enum kernel_table table;
+    gamma_kernel kernel = select_kernel(plan, version, &table);
+    if (!kernel) {
+        return GAMMA_ERROR_VERSION;
+    }
+    uint16_t* gamma16 = NULL;
+    if (table == TABLE_GAMMA16 && !plan->tables.gamma16) {
+        gamma16 = malloc(((size_t)plan->tables.max_val + 1) * sizeof(uint16_t));
+        if (!gamma16) {
+            return GAMMA_ERROR_MEMORY;
+        }
+        plan->tables.gamma16 = gamma16;
+    }
+    plan->kernel = kernel;
+    plan->table = table;
+    plan->post = table == TABLE_NONE && plan->ops.count > 0;
+    build_tables(plan);
+    return GAMMA_OK;
+}
+
+// Changes the gamma value of a plan and rebuilds its tables
+void plan_set_gamma(struct kernel_plan* plan, float gamma){
+    plan->gamma = gamma;
+    if (plan->kernel) {
+        build_tables(plan);
+    }
+}
+
+// Lets the kernels run their last vector of every row into the padding behind it. Only for images and results that
+// come from image_alloc(): a wide stride alone says nothing, e.g. a region of a larger image has its neighbours there.
+void plan_set_padded(struct kernel_plan* plan, int padded){
+    plan->tables.padded = padded;
+}
+
+// Releases the tables a plan allocated, plan_kernel() may be called again afterwards
+void plan_free(struct kernel_plan* plan){
+    free(plan->tables.gamma16);
+    plan->tables.gamma16 = NULL;
+    plan->kernel = NULL;
+}
+
+// Runs the kernel of the plan on the given rows, followed by the operations if they are not fused into its table
+void plan_run(const struct kernel_plan* plan, const uint8_t* img, size_t width, size_t height, size_t stride, uint8_t* result, size_t result_stride){
+    plan->kernel(img, width, height, stride, plan->a, plan->b, plan->c, plan->gamma, result, result_stride, &plan->tables);
+    if (plan->post) {
+        pipeline_apply(plan->tables.ops, result, width, height, result_stride);
+    }
+}
+
+// Brand string of the CPU from cpuid, used as part of the cache key
+static void cpu_model(char* model, size_t size){
+    unsigned int regs[12];
+    if (__get_cpuid_max(0x80000000, NULL) < 0x80000004) {
+        snprintf(model, size, "unknown");
+        return;
+    }
+    for (unsigned int i = 0; i < 3; i++) {
+        __get_cpuid(0x80000002 + i, &regs[i * 4], &regs[i * 4 + 1], &regs[i * 4 + 2], &regs[i * 4 + 3]);
+    }
+    char brand[49];
+    memcpy(brand, regs, 48);
+    brand[48] = '\0';
+
+    // Trim the padding and replace tabs, the cache file is tab separated
+    char* start = brand;
+    while (*start == ' ') {
+        start++;
+    }
+    size_t length = strlen(start);
+    while (length > 0 && start[length - 1] == ' ') {
+        start[--length] = '\0';
+    }
+    for (char* p = start; *p; p++) {
+        if (*p == '\t') {
+            *p = ' ';
+        }
+    }
+    snprintf(model, size, "%s", start);
+}
+
+// FNV-1a hash of the operations with their parameters, so pipelines of the same length get different cache keys
+static uint32_t ops_hash(const struct point_pipeline* ops){
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < ops->count; i++) {
+        uint32_t words[3] = {(uint32_t)ops->ops[i].type, 0, 0};
+        memcpy(&words[1], &ops->ops[i].x, sizeof(float));
+        memcpy(&words[2], &ops->ops[i].y, sizeof(float));
+        const uint8_t* bytes = (const uint8_t*)words;
+        for (size_t j = 0; j < sizeof(words); j++) {
+            hash = (hash ^ bytes[j]) * 16777619u;
+        }
+    }
+    return hash;
+}
+
+// Cache lines: <cpu model>\t<isa>\t<width>\t<bits>\t<accuracy>\t<precision>\t<threads>\t<operations>\t<version>
+// where <operations> is the number of operations and their ops_hash(), e.g. 2:1a2b3c4d
+static int cache_lookup(const char* cache, const char* key){
+    FILE* file = fopen(cache, "r");
+    if (!file) {
+        return -1;
+    }
+    int version = -1;
+    char line[512];
+    size_t key_length = strlen(key);
+    while (fgets(line, sizeof(line), file)) {
+        if (strncmp(line, key, key_length) == 0 && line[key_length] == '\t') {
+            version = atoi(line + key_length + 1);          // the last matching line wins
+        }
+    }
+    fclose(file);
+    return version >= 0 && version < NUM_VERSIONS ? version : -1;
+}
+
+static void cache_store(const char* cache, const char* key, int version){
+    FILE* file = fopen(cache, "a");
+    if (!file) {
+        return;                     // caching is an optimisation only
+    }
+    fprintf(file, "%s\t%d\n", key, version);
+    fclose(file);
+}
+
+static double elapsed(const struct timespec* start, const struct timespec* end){
+    return (end->tv_sec - start->tv_sec) + 1e-9 * (end->tv_nsec - start->tv_nsec);
+}
+
+/*
+ * Picks the fastest version whose accuracy class is at least as good as the requested one (-V auto).
+ *
+ * Parameters:
+ *  - const uint8_t* img, size_t width, size_t height, size_t stride: The image that is going to be processed. If img is NULL (the
+ *    modes that never hold the whole image), a synthetic gradient of the given width is measured instead.
+ *  - const struct kernel_plan* base: Parameters and operations of the run, the kernel is not used.
+ *  - enum accuracy_class accuracy: Least accurate class that is acceptable.
+ *  - thread_pool* pool: The pool of the actual run, so the measurement includes its scaling.
+ *  - const char* cache: File caching earlier decisions, NULL disables the cache.
+ *  - FILE* info: Stream for the tuning report.
+ *
+ * Returns:
+ *  - int: The chosen version, 0 if there is no memory for the measurement.
+ *
+ * Description:
+ * Every eligible version runs on a sample of the image (whole rows from the middle, about 256K pixels): one warmup
+ * call, then the median of five timed calls decides. The decision is appended to the cache keyed by CPU model,
+ * instruction set, image width, bits per sample, accuracy class, --precision (it changes the class of some kernels),
+ * thread count and the operations with their parameters, so later runs on the same machine skip the tuning. Every version is measured
+ * through plan_run() with the operations of the base plan, fused or as a pass, as the actual run does them. For 16 bit images (a max value above 255 in the base plan) the 16
+ * bit variants are measured.
+ */
+int autotune(const uint8_t* img, size_t width, size_t height, size_t stride, const struct kernel_plan* base, enum accuracy_class accuracy, thread_pool* pool, const char* cache, FILE* info){
+    char model[64];
+    cpu_model(model, sizeof(model));
+    int sample_bits = base->max_val > 255 ? 16 : 8;
+    char key[160];
+    static const char* precision_names[] = {[POW_LOW] = "low", [POW_MEDIUM] = "medium", [POW_HIGH] = "high"};
+    snprintf(key, sizeof(key), "%s\t%s\t%zu\t%d\t%s\t%s\t%u\t%zu:%08x", model, cpu_isa_name(cpu_active_isa()), width, sample_bits,
+             accuracy_name(accuracy), precision_names[getPowPrecision()], threadpool_size(pool), base->ops.count,
+             (unsigned)ops_hash(&base->ops));
+
+    int cached = cache ? cache_lookup(cache, key) : -1;
+    if (cached >= 0) {
+        fprintf(info, "Autotuning: version %d taken from %s. \n", cached, cache);
+        return cached;
+    }
+
+    size_t rows = (256 * 1024 + width - 1) / width;
+    if (img && rows > height) {
+        rows = height;
+    }
+    size_t sample_bytes = (size_t)sample_bits / 8;
+    uint8_t* synthetic = NULL;
+    if (!img) {
+        synthetic = malloc(width * rows * 3 * sample_bytes);
+        if (!synthetic) {
+            fprintf(info, "Autotuning: no memory for the sample, version 0 is used. \n");
+            return 0;
+        }
+        for (size_t i = 0; i < width * rows * 3 * sample_bytes; i++) {
+            synthetic[i] = (uint8_t)(i * 7 + i / 3);
+        }
+    }
+    const uint8_t* sample = img ? img + (height - rows) / 2 * stride : synthetic;
+    if (!img) {
+        stride = width * 3 * sample_bytes;
+    }
+    uint8_t* result = malloc(width * rows * sample_bytes);
+    if (!result) {
+        free(synthetic);
+        fprintf(info, "Autotuning: no memory for the sample, version 0 is used. \n");
+        return 0;
+    }
+
+    int best = 0;
+    double best_time = 0;
+    struct kernel_plan* plan = malloc(sizeof(*plan));
+    if (!plan) {
+        free(result);
+        free(synthetic);
+        fprintf(info, "Autotuning: no memory for the sample, version 0 is used. \n");
+        return 0;
+    }
+    for (int version = 0; version < NUM_VERSIONS; version++) {
+        const struct kernel_desc* k = find_kernel(version);
+        gamma_kernel kernel = k ? (sample_bits == 16 ? k->kernel16 : k->kernel) : NULL;
+        if (!kernel || kernel_accuracy(k) > accuracy) {
+            continue;
+        }
+        plan_init(plan, base->a, base->b, base->c, base->gamma, base->max_val, base->color, &base->ops);
+        if (plan_kernel(plan, version) != GAMMA_OK) {
+            continue;
+        }
+
+        double times[5];
+        threadpool_run(pool, plan, sample, width, rows, stride, result, width * sample_bytes);
+        for (int i = 0; i < 5; i++) {
+            struct timespec start, end;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            threadpool_run(pool, plan, sample, width, rows, stride, result, width * sample_bytes);
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            times[i] = elapsed(&start, &end);
+        }
+        plan_free(plan);
+        // median of five by partial sorting
+        for (int i = 0; i < 3; i++) {
+            for (int j = i + 1; j < 5; j++) {
+                if (times[j] < times[i]) {
+                    double t = times[i];
+                    times[i] = times[j];
+                    times[j] = t;
+                }
+            }
+        }
+        fprintf(info, "Autotuning: version %d (%s, %s, accuracy %s) takes %lf ms for %zu rows. \n", version, k->name,
+                cpu_isa_name(k->isa), accuracy_name(kernel_accuracy(k)), times[2] * 1e3, rows);
+        if (best_time == 0 || times[2] < best_time) {
+            best = version;
+            best_time = times[2];
+        }
+    }
+    free(plan);
+    free(result);
+    free(synthetic);
+
+    if (cache) {
+        cache_store(cache, key, best);
+    }
+    fprintf(info, "Autotuning: version %d is the fastest with accuracy %s or better. \n", best, accuracy_name(accuracy));
+    return best;
+}
@@ -0,0 +1,74 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "cpu_dispatch.h"
+#include "threadpool.h"
+#include "pipeline.h"
+#include "kernel_tables.h"
+
+// Number of -V versions, the value of -V all and of -V auto
+#define NUM_VERSIONS 9
+#define VERSION_ALL UINT32_MAX
+#define VERSION_AUTO (UINT32_MAX - 1)
+
+// Local file caching the decisions of the autotuner
+#define TUNE_CACHE_FILE ".gamma_autotune"
+
+// How close a kernel stays to the gamma_V0 reference (see --compare), ordered from most to least accurate
+enum accuracy_class {
+    ACCURACY_EXACT,       // the reference itself
+    ACCURACY_HIGH,        // at most a few gray levels off
+    ACCURACY_MEDIUM,      // gray value rounded to 8 bit before the gamma step, large errors near black for small gamma
+    ACCURACY_LOW,         // truncated series or interpolation, may be off by up to 255
+};
+
+// Table of struct kernel_tables a kernel looks its results up in, the operations of --ops are fused into it
+enum kernel_table {
+    TABLE_NONE,           // computes every result, the operations run as a pass over its output
+    TABLE_GAMMA,          // kernel_tables.gamma
+    TABLE_FINE,           // kernel_tables.fine
+    TABLE_GAMMA16,        // kernel_tables.gamma16, allocated for the max value of the plan
+};
+
+struct kernel_desc {
+    int version;                   // -V number
+    const char* name;
+    gamma_kernel kernel;
+    enum isa_level isa;            // instruction set the kernel needs
+    enum accuracy_class accuracy;
+    gamma_kernel kernel16;         // variant for 16 bit images, NULL if the version has none
+    enum kernel_table table;       // table of the 8 bit kernel
+    int fast_pow;                  // uses the pow approximation of fastpow.h, its accuracy depends on --precision
+};
+
+// Everything a run needs besides the image: the kernel of a version and the tables it reads, built once (plan_kernel())
+struct kernel_plan {
+    gamma_kernel kernel;
+    float a, b, c, gamma;
+    int max_val;                   // of the images, above 255 the samples have 16 bits
+    int color;                     // gamma per channel, the result is RGB
+    struct point_pipeline ops;     // --ops, applied to the gray values after the gamma correction
+    enum kernel_table table;
+    int post;                      // the operations run as a pass over the output of the kernel (tables.ops)
+    struct kernel_tables tables;
+};
+
+extern const struct kernel_desc kernel_registry[];
+extern const size_t kernel_registry_size;
+
+const struct kernel_desc* find_kernel(int version);
+void plan_init(struct kernel_plan* plan, float a, float b, float c, float gamma, int max_val, int color, const struct point_pipeline* ops);
+int plan_kernel(struct kernel_plan* plan, int version);
+void plan_set_gamma(struct kernel_plan* plan, float gamma);
+void plan_set_padded(struct kernel_plan* plan, int padded);
+void plan_free(struct kernel_plan* plan);
+void plan_run(const struct kernel_plan* plan, const uint8_t* img, size_t width, size_t height, size_t stride, uint8_t* result, size_t result_stride);
+enum accuracy_class kernel_accuracy(const struct kernel_desc* kernel);
+const char* accuracy_name(enum accuracy_class accuracy);
+int parse_accuracy(const char* name, enum accuracy_class* accuracy);
+int autotune(const uint8_t* img, size_t width, size_t height, size_t stride, const struct kernel_plan* base, enum accuracy_class accuracy, thread_pool* pool, const char* cache, FILE* info);
+
+#endif  // KERNELS_H
@@ -0,0 +1,464 @@
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "libgamma.h"
+#include "libgamma_internal.h"
+#include "kernels.h"
+#include "threadpool.h"
+#include "image.h"
+#include "bufpool.h"
+
+struct gamma_context {
+    thread_pool* pool;
+    struct kernel_plan plan;      // kernel, parameters, operations and tables of this context only
+};
+
+static const char* status_messages[] = {
+    [GAMMA_OK] = "Success",
+    [GAMMA_ERROR_ARGUMENT] = "Invalid argument",
+    [GAMMA_ERROR_VERSION] = "Invalid version",
+    [GAMMA_ERROR_MEMORY] = "Memory allocation failed",
+    [GAMMA_ERROR_IO] = "Error reading or writing the file",
+    [GAMMA_ERROR_FORMAT] = "Invalid or truncated PPM file",
+    [GAMMA_ERROR_RANGE] = "Pixel value exceeds the maximum value",
+};
+
+const char* gamma_strerror(int status){
+    if (status < 0 || (size_t)status >= sizeof(status_messages) / sizeof(status_messages[0])) {
+        return "Unknown error";
+    }
+    return status_messages[status];
+}
+
+/*
+ * Creates a context for processing images with the same parameters.
+ *
+ * Parameters:
+ *  - const struct gamma_config* config: Version, coefficients, gamma, threads, operations and the format of the images.
+ *  - gamma_context** context: Receives the context, released with gamma_destroy().
+ *
+ * Returns:
+ *  - int: GAMMA_OK, GAMMA_ERROR_ARGUMENT (also for a malformed ops string, a max value outside [0, 65535] and
+ *    operations or color mode with 16 bit samples), GAMMA_ERROR_VERSION or GAMMA_ERROR_MEMORY.
+ *
+ * Description:
+ * The kernel is resolved once with plan_kernel(), so the instruction set dispatch is fixed at this point, and the
+ * lookup tables of the kernel are built with the operations fused in; gamma_set_version() and gamma_set_gamma() rebuild
+ * them. The plan and the pool of a context are its own, contexts with different operations and formats can be used side
+ * by side from different threads (see libgamma.h for the state they share). For more than one thread the worker threads are started here and stay alive until
+ * gamma_destroy().
+ */
+int gamma_create(const struct gamma_config* config, gamma_context** context){
+    if (!config || !context || !(config->gamma >= 0) || !(config->a >= 0) || !(config->b >= 0) || !(config->c >= 0) ||
+        config->max_val < 0 || config->max_val > 65535) {
+        return GAMMA_ERROR_ARGUMENT;
+    }
+    struct point_pipeline ops;
+    pipeline_init(&ops);
+    if (config->ops && !pipeline_parse(&ops, config->ops)) {
+        return GAMMA_ERROR_ARGUMENT;
+    }
+
+    gamma_context* ctx = calloc(1, sizeof(gamma_context));
+    if (!ctx) {
+        return GAMMA_ERROR_MEMORY;
+    }
+    int max_val = config->max_val > 0 ? config->max_val : 255;
+    plan_init(&ctx->plan, config->a, config->b, config->c, config->gamma, max_val, config->color, &ops);
+    int status = plan_kernel(&ctx->plan, config->version);
+    if (status != GAMMA_OK) {
+        free(ctx);
+        return status;
+    }
+    if (config->threads > 1) {
+        ctx->pool = threadpool_create(config->threads);
+        if (!ctx->pool) {
+            plan_free(&ctx->plan);
+            free(ctx);
+            return GAMMA_ERROR_MEMORY;
+        }
+    }
+    *context = ctx;
+    return GAMMA_OK;
+}
+
+void gamma_destroy(gamma_context* context){
+    if (!context) {
+        return;
+    }
+    threadpool_destroy(context->pool);
+    plan_free(&context->plan);
+    free(context);
+}
+
+// Switches to another version, the context is unchanged if there is no such version
+int gamma_set_version(gamma_context* context, int version){
+    if (!context) {
+        return GAMMA_ERROR_ARGUMENT;
+    }
+    return plan_kernel(&context->plan, version);
+}
+
+int gamma_set_gamma(gamma_context* context, float gamma){
+    if (!context || !(gamma >= 0)) {
+        return GAMMA_ERROR_ARGUMENT;
+    }
+    plan_set_gamma(&context->plan, gamma);
+    return GAMMA_OK;
+}
+
+/*
+ * Converts an RGB image to gray and applies the gamma correction of the context.
+ *
+ * Strides are in bytes. The samples have the format of the context: 8 bit, or 16 bit in host byte order with 2 byte
+ * aligned rows if its max value is above 255; the result has the same sample size and one channel, three in color
+ * mode. Strides too small for that are rejected with GAMMA_ERROR_ARGUMENT. Only the pixels of every row are read and
+ * written, the bytes between the end of a row and the stride stay untouched, so the image and the result may be regions
+ * of larger ones. The image is split into one band of rows
+ * per thread; nothing is allocated, so the call can be repeated for every frame of a stream without touching the heap.
+ */
+int gamma_process(gamma_context* context, const uint8_t* img, size_t width, size_t height, size_t stride, uint8_t* result, size_t result_stride){
+    if (!context || ((!img || !result) && width > 0 && height > 0)) {
+        return GAMMA_ERROR_ARGUMENT;
+    }
+    size_t sample_bytes = context->plan.max_val > 255 ? 2 : 1;
+    size_t channels = context->plan.color ? 3 : 1;
+    if (width > SIZE_MAX / 3 / sample_bytes || stride < width * 3 * sample_bytes || result_stride < width * sample_bytes * channels) {
+        return GAMMA_ERROR_ARGUMENT;
+    }
+    if (sample_bytes == 2 && (((uintptr_t)img | (uintptr_t)result | stride | result_stride) & 1)) {
+        return GAMMA_ERROR_ARGUMENT;
+    }
+    threadpool_run(context->pool, &context->plan, img, width, height, stride, result, result_stride);
+    return GAMMA_OK;
+}
+
+/*
+ * gamma_process() for an image of gamma_read_p6(): images whose samples the context can't process are rejected with
+ * GAMMA_ERROR_FORMAT, i.e. 16 bit images for an 8 bit context and the other way round, and 16 bit images with another
+ * max value than the context, whose gray values would be scaled wrongly.
+ */
+int gamma_process_image(gamma_context* context, const struct gamma_image* image, uint8_t* result, size_t result_stride){
+    if (!context || !image) {
+        return GAMMA_ERROR_ARGUMENT;
+    }
+    int max_val = context->plan.max_val;
+    if ((image->max_val > 255) != (max_val > 255) || (max_val > 255 && image->max_val != max_val)) {
+        return GAMMA_ERROR_FORMAT;
+    }
+    return gamma_process(context, image->image, image->width, image->height, image->stride, result, result_stride);
+}
+
+// Tells the context that every image and result passed to it comes from image_alloc() (--aligned), so the kernels may
+// run into the row padding (see plan_set_padded()). Callers of the library never get this: their strides say nothing
+// about what lies behind a row.
+void gamma_set_padded(gamma_context* context, int padded){
+    plan_set_padded(&context->plan, padded);
+}
+
+// Pool of the context, NULL for a single thread; the command line tool shares it with its other modes
+thread_pool* gamma_context_pool(const gamma_context* context){
+    return context ? context->pool : NULL;
+}
+
+static void skip_spaces(FILE* file) {
+    int c;
+    while ((c = fgetc(file)) == ' ' || c == '\t' || c == '\r' || c == '\n') {
+        // Continue reading characters until a non-whitespace character is encountered
+    }
+    if (c != EOF) {
+        ungetc(c, file);
+    }
+}
+
+static void skip_comments(FILE* file) {
+    int ch;
+    do {
+        while ((ch = fgetc(file)) == '#') {
+            // If a comment is found, read until the end of the line
+            while ((ch = fgetc(file)) != '\n' && ch != EOF) {
+                // Continue reading characters until a newline or end of file is encountered
+            }
+        }
+        // Move the file pointer back by one character if it's not the end of file
+        if (ch != EOF) {
+            ungetc(ch, file);
+        }
+    } while (ch == '#');
+}
+
+// Error of a failed fscanf/fread: GAMMA_ERROR_IO if the stream failed, otherwise the file is truncated or malformed
+static int read_error(FILE* file) {
+    return ferror(file) ? GAMMA_ERROR_IO : GAMMA_ERROR_FORMAT;
+}
+
+// Reads the P6 header up to the first pixel byte: the file is positioned at the start of the pixel data afterwards
+int gamma_read_header(FILE* file, size_t* width, size_t* height, int* max_val) {
+    skip_comments(file);
+
+    char magic[3];
+    if (fscanf(file, "%2s", magic) != 1) {           //Reading the header of the P6 file
+        return read_error(file);
+    }
+    skip_comments(file);
+    if (magic[0] != 'P' || magic[1] != '6') {       //Checking the header if it is right or not
+        return GAMMA_ERROR_FORMAT;
+    }
+
+    skip_spaces(file);
+    skip_comments(file);
+    int temp_width, temp_height;
+    if (fscanf(file, "%d %d", &temp_width, &temp_height) != 2) {         //Reading the width and height
+        return read_error(file);
+    }
+    if (temp_width <= 0 || temp_height <= 0) {
+        return GAMMA_ERROR_FORMAT;
+    }
+
+    skip_spaces(file);
+    skip_comments(file);
+    int temp_max_val;
+    if (fscanf(file, "%d", &temp_max_val) != 1) {       // reading max value
+        return read_error(file);
+    }
+    // above 255 every sample has two bytes
+    if (temp_max_val < 0 || temp_max_val > 65535) {
+        return GAMMA_ERROR_FORMAT;
+    }
+
+    fgetc(file); // Read newline character
+    *width = (size_t)temp_width;
+    *height = (size_t)temp_height;
+    *max_val = temp_max_val;
+    return GAMMA_OK;
+}
+
+/*
+ * Reads a P6 image from a stream into padded, 64 byte aligned rows (see image_alloc()).
+ *
+ * 16 bit samples are converted to the host byte order. On success the image is released with gamma_free_image(); on
+ * error there is nothing to release, but width, height and max_val hold the values of the header if it was valid.
+ */
+int gamma_read_p6(FILE* file, struct gamma_image* image) {
+    *image = (struct gamma_image){0};
+    int status = gamma_read_header(file, &image->width, &image->height, &image->max_val);
+    if (status != GAMMA_OK) {
+        return status;
+    }
+    size_t sample_bytes = image->max_val > 255 ? 2 : 1;
+    size_t row_bytes = image->width * 3 * sample_bytes;
+
+    //allocating memory for the pixels of the image: 64 byte aligned rows with padding, so the kernels need no tail
+    uint8_t* pixels = image_alloc(image->width, image->height, 3 * sample_bytes, &image->stride);
+    if (!pixels) {
+        return GAMMA_ERROR_MEMORY;
+    }
+
+    for (size_t y = 0; y < image->height; y++) {
+        uint8_t* row = pixels + y * image->stride;
+        if (fread(row, sizeof(uint8_t), row_bytes, file) != row_bytes) {
+            status = read_error(file);
+            break;
+        }
+        if (sample_bytes == 2) {
+            image_swap16(row, image->width * 3);       // the file stores the most significant byte first
+        }
+        if (sample_bytes == 2 ? !check_max_val16((const uint16_t*)row, image->width * 3, image->max_val) : !check_max_val(row, image->width * 3, image->max_val)) {
+            status = GAMMA_ERROR_RANGE;
+            break;
+        }
+    }
+    if (status != GAMMA_OK) {
+        image_free(pixels);
+        return status;
+    }
+    image->image = pixels;
+    return GAMMA_OK;
+}
+
+// Reads a file that can't be mapped with gamma_read_p6()
+static int read_p6_file(const char* filename, struct gamma_image* image) {
+    FILE* file = fopen(filename, "rb");
+    if (!file) {
+        *image = (struct gamma_image){0};
+        return GAMMA_ERROR_IO;
+    }
+    int status = gamma_read_p6(file, image);
+    fclose(file);
+    return status;
+}
+
+/*
+ * Reads a P6 image by mapping the file into memory instead of copying it.
+ *
+ * The header is parsed directly from the mapping (through fmemopen, so the same parser as gamma_read_p6() is used) and
+ * the returned image points into the mapping right behind the header: there is no malloc and no copy of the pixel data.
+ * With the usual max value 255 every byte is valid and the pixels aren't touched at all before the kernel runs, other
+ * max values need one validation pass over the mapping. Files that can't be mapped (pipes, empty files) and 16 bit
+ * images, whose samples have to be converted to the host byte order anyway, are read with gamma_read_p6(). The image
+ * must be released with gamma_free_image().
+ */
+int gamma_read_p6_mmap(const char* filename, struct gamma_image* image) {
+    struct stat st;
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return read_p6_file(filename, image);
+    }
+
+    size_t size = (size_t)st.st_size;
+    uint8_t* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);                                      // the mapping stays valid without the descriptor
+    if (map == MAP_FAILED) {
+        return read_p6_file(filename, image);
+    }
+    madvise(map, size, MADV_SEQUENTIAL | MADV_WILLNEED);
+
+    *image = (struct gamma_image){0};
+    FILE* header = fmemopen(map, size, "rb");
+    if (!header) {
+        munmap(map, size);
+        return GAMMA_ERROR_IO;
+    }
+    int status = gamma_read_header(header, &image->width, &image->height, &image->max_val);
+    size_t offset = (size_t)ftell(header);
+    fclose(header);
+    if (status == GAMMA_OK && image->max_val > 255) {
+        munmap(map, size);
+        return read_p6_file(filename, image);
+    }
+
+    size_t bytes = image->width * image->height * 3;
+    if (status == GAMMA_OK && (offset > size || size - offset < bytes)) {
+        status = GAMMA_ERROR_FORMAT;
+    }
+    if (status == GAMMA_OK && !check_max_val(map + offset, bytes, image->max_val)) {
+        status = GAMMA_ERROR_RANGE;
+    }
+    if (status != GAMMA_OK) {
+        munmap(map, size);
+        return status;
+    }
+
+    image->image = map + offset;
+    image->stride = image->width * 3;            // the rows of the file have no padding
+    image->map = map;
+    image->map_size = size;
+    return GAMMA_OK;
+}
+
+// Releases an image returned by gamma_read_p6() or gamma_read_p6_mmap()
+void gamma_free_image(struct gamma_image* image) {
+    if (image->map) {
+        munmap(image->map, image->map_size);
+    } else {
+        image_free(image->image);
+    }
+    image->image = NULL;
+    image->map = NULL;
+}
+
+// Returns the buffers that released images left in the pool to the system, e.g. after a burst of large images
+void gamma_trim(void) {
+    bufpool_trim();
+}
+
+// Writes all vectors, also if writev only takes a part of them; returns -1 with errno set on failure
+static int writev_all(int fd, struct iovec* pending, int count) {
+    while (count > 0) {
+        ssize_t n = writev(fd, pending, count);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return -1;
+        }
+        // Skip everything that was written, including partially written vectors
+        while (count > 0 && (size_t)n >= pending->iov_len) {
+            n -= (ssize_t)pending->iov_len;
+            pending++;
+            count--;
+        }
+        if (count > 0) {
+            pending->iov_base = (uint8_t*)pending->iov_base + n;
+            pending->iov_len -= (size_t)n;
+        }
+    }
+    return 0;
+}
+
+// Rows per writev call for padded images, far below IOV_MAX
+#define WRITE_ROWS_PER_CALL 64
+
+/*
+ * Writes header and rows of row_bytes bytes each to a descriptor, shared by all gamma_write_* functions.
+ *
+ * Header and pixel buffer are handed to the kernel in a single writev call instead of one fwrite per pixel; the loop
+ * only repeats if the kernel accepts fewer bytes than requested (e.g. on a pipe).
+ */
+static int write_rows(int fd, const char* header, int header_length, const uint8_t* image, size_t row_bytes, size_t height, size_t stride) {
+    if (stride == row_bytes) {
+        struct iovec iov[2] = {
+            {(char*)header, (size_t)header_length},
+            {(uint8_t*)image, row_bytes * height},
+        };
+        return writev_all(fd, iov, 2) == 0 ? GAMMA_OK : GAMMA_ERROR_IO;
+    }
+
+    // Padded rows: one vector per row, the padding stays in memory
+    struct iovec iov[WRITE_ROWS_PER_CALL + 1] = {{(char*)header, (size_t)header_length}};
+    int count = 1;
+    for (size_t y = 0; y < height; y++) {
+        iov[count].iov_base = (uint8_t*)image + y * stride;
+        iov[count].iov_len = row_bytes;
+        count++;
+        if (count == WRITE_ROWS_PER_CALL + 1 || y + 1 == height) {
+            if (writev_all(fd, iov, count) != 0) {
+                return GAMMA_ERROR_IO;
+            }
+            count = 0;
+        }
+    }
+    if (count > 0 && writev_all(fd, iov, count) != 0) {         // header of an image without rows
+        return GAMMA_ERROR_IO;
+    }
+    return GAMMA_OK;
+}
+
+// Writes a gray image with max value 255 as P5 file to a descriptor
+int gamma_write_p5(int fd, const uint8_t* image, size_t width, size_t height, size_t stride) {
+    char header[64];
+    int header_length = snprintf(header, sizeof(header), "P5\n%zu %zu\n255\n", width, height);
+    return write_rows(fd, header, header_length, image, width, height, stride);
+}
+
+/*
+ * Writes a 16 bit image (samples in host byte order, stride in bytes) as P5 file with the given max value.
+ *
+ * The samples are swapped to big endian in place, the image can't be used afterwards.
+ */
+int gamma_write_p5_16(int fd, uint8_t* image, size_t width, size_t height, size_t stride, int max_val) {
+    for (size_t y = 0; y < height; y++) {
+        image_swap16(image + y * stride, width);
+    }
+    char header[64];
+    int header_length = snprintf(header, sizeof(header), "P5\n%zu %zu\n%d\n", width, height, max_val);
+    return write_rows(fd, header, header_length, image, width * 2, height, stride);
+}
+
+// Writes an RGB image with max value 255 as P6 file to a descriptor
+int gamma_write_p6(int fd, const uint8_t* image, size_t width, size_t height, size_t stride) {
+    char header[64];
+    int header_length = snprintf(header, sizeof(header), "P6\n%zu %zu\n255\n", width, height);
+    return write_rows(fd, header, header_length, image, width * 3, height, stride);
+}
@@ -0,0 +1,84 @@
+#ifndef LIBGAMMA_H
+#define LIBGAMMA_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * libgamma: grayscale conversion with gamma correction as a library (libgamma.a, libgamma.so).
+ *
+ * A context is created once with the version, coefficients, gamma, number of threads, point operations and the format
+ * of the images; it resolves the kernel, builds its tables and starts the worker threads. gamma_process() can then be called for any number of images without allocating anything.
+ * No function of the library exits the process, every error is returned as enum gamma_status. The pixels of
+ * gamma_read_p6() come from a pool of buffers (bufpool.h): an image released with gamma_free_image() is reused by the
+ * next one that fits, so reading one image after another stops allocating and taking page faults.
+ *
+ * The kernel, its tables, the operations and the format belong to the context: contexts with different operations,
+ * sample sizes or color mode can be used at the same time, each one from its own thread. By default a context converts
+ * 8 bit RGB to 8 bit gray. gamma_process() reads and writes only the pixels of every row, never the bytes between the
+ * end of a row and the stride, so images may be regions of larger ones.
+ *
+ * State shared by the whole process:
+ *  - The buffer pool. It is thread safe and keeps up to 32 released images and 512 MB cached until gamma_trim().
+ *  - The instruction set of the CPU, detected once with cpuid when the first kernel is chosen.
+ *  - The instruction set limit (--isa), the strip size of version 7 (--tile) and the pow precision of versions 4 and 8
+ *    (--precision) of the command line tool. The library has no call to change them, its contexts always run with the
+ *    defaults: the widest instruction set, GAMMA_V2_DEFAULT_TILE and the medium precision.
+ */
+
+enum gamma_status {
+    GAMMA_OK = 0,
+    GAMMA_ERROR_ARGUMENT,       // NULL pointer, stride smaller than a row, negative gamma or coefficients
+    GAMMA_ERROR_VERSION,        // no version with this number
+    GAMMA_ERROR_MEMORY,         // allocation or thread creation failed
+    GAMMA_ERROR_IO,             // reading or writing failed, errno holds the reason
+    GAMMA_ERROR_FORMAT,         // not a P6 file, a damaged header, or samples the context doesn't process
+    GAMMA_ERROR_RANGE,          // a sample is above the max value of the header
+};
+
+struct gamma_config {
+    int version;                // -V number, 0 to 8
+    float a, b, c;              // coefficients of the grayscale conversion
+    float gamma;
+    unsigned threads;           // threads processing one band of rows each, 0 and 1 run on the calling thread
+    const char* ops;            // point operations like --ops, e.g. "brightness=10,invert"; NULL for none
+    int max_val;                // max value of the images, above 255 they have 16 bit samples; 0 means 255
+    int color;                  // gamma correction per channel, the result is RGB like the input (8 bit only)
+};
+
+// Defaults of the command line tool
+#define GAMMA_CONFIG_DEFAULT {0, 0.299f, 0.587f, 0.114f, 0.5f, 1, NULL, 255, 0}
+
+typedef struct gamma_context gamma_context;
+
+// An RGB image as read from a P6 file, samples in host byte order
+struct gamma_image {
+    size_t width;
+    size_t height;
+    size_t stride;       // bytes from one row to the next, width * 3 or the padded stride of image_alloc()
+    uint8_t* image;      // 8 bit samples, or 16 bit samples in host byte order if max_val is above 255
+    int max_val;
+    void* map;           // start of the file mapping if image points into one, NULL if image was malloced
+    size_t map_size;
+};
+
+const char* gamma_strerror(int status);
+
+int gamma_create(const struct gamma_config* config, gamma_context** context);
+void gamma_destroy(gamma_context* context);
+int gamma_set_version(gamma_context* context, int version);
+int gamma_set_gamma(gamma_context* context, float gamma);
+int gamma_process(gamma_context* context, const uint8_t* img, size_t width, size_t height, size_t stride, uint8_t* result, size_t result_stride);
+int gamma_process_image(gamma_context* context, const struct gamma_image* image, uint8_t* result, size_t result_stride);
+
+int gamma_read_header(FILE* file, size_t* width, size_t* height, int* max_val);
+int gamma_read_p6(FILE* file, struct gamma_image* image);
+int gamma_read_p6_mmap(const char* filename, struct gamma_image* image);
+void gamma_free_image(struct gamma_image* image);
+void gamma_trim(void);
+int gamma_write_p5(int fd, const uint8_t* image, size_t width, size_t height, size_t stride);
+int gamma_write_p5_16(int fd, uint8_t* image, size_t width, size_t height, size_t stride, int max_val);
+int gamma_write_p6(int fd, const uint8_t* image, size_t width, size_t height, size_t stride);
+
+#endif // LIBGAMMA_H
@@ -0,0 +1,12 @@
+#ifndef LIBGAMMA_INTERNAL_H
+#define LIBGAMMA_INTERNAL_H
+
+#include "libgamma.h"
+#include "threadpool.h"
+
+// Parts of libgamma used by the command line tool only, they are not in the public header
+
+void gamma_set_padded(gamma_context* context, int padded);
+thread_pool* gamma_context_pool(const gamma_context* context);
+
+#endif  // LIBGAMMA_INTERNAL_H
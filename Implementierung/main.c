@@ -1,3 +1,4 @@
+#define _POSIX_C_SOURCE 199309L
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
@@ -9,12 +10,132 @@
 #include "read.h"
 #include "parse.h"
 #include "write.h"
-#include "gamma_V0.h"
-#include "gamma_V1.h"
-#include "gamma_V2.h"
-#include "gamma_V3.h"
-#include "gamma_V4.h"
 #include "benchmarking.h"
+#include "cpu_dispatch.h"
+#include "kernels.h"
+#include "image.h"
+#include "threadpool.h"
+#include "stream.h"
+#include "ingest.h"
+#include "batch.h"
+#include "async_io.h"
+#include "accuracy.h"
+#include "pipeline.h"
+#include "gamma16.h"
+#include "autogamma.h"
+#include "server.h"
+#include "libgamma.h"
+#include "libgamma_internal.h"
+#include "bufpool.h"
+
+// Kernel and parameters for processing the chunks of the parallel reader as soon as they arrive
+struct fused_kernel {
+    const struct kernel_plan* plan;
+    size_t width;
+    uint8_t* result;
+};
+
+static void process_chunk(void* ctx, const uint8_t* pixels, size_t first_row, size_t rows){
+    struct fused_kernel* job = ctx;
+    plan_run(job->plan, pixels, job->width, rows, job->width * 3, job->result + first_row * job->width, job->width);
+}
+
+// Replaces -V auto by the version the autotuner picks; img may be NULL if the mode never holds the whole image
+static void resolve_version(struct arg* d, const uint8_t* img, size_t width, size_t height, const struct kernel_plan* plan, thread_pool* pool, FILE* info){
+    if (d->V == VERSION_AUTO) {
+        d->V = (uint32_t)autotune(img, width, height, d->stride, plan, d->accuracy, pool, d->tune_cache, info);
+    }
+}
+
+// Chooses the kernel of the selected version for the modes that run a plan directly instead of the context
+static void plan_version(struct kernel_plan* plan, uint32_t version){
+    if (plan_kernel(plan, (int)version) != GAMMA_OK) {
+        fprintf(stderr,"Invalid version\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Runs the -B repetitions of the selected version (or of all versions for -Vall), prints and optionally exports the statistics;
+// pixel_bytes is the number of bytes read and written per pixel
+static void run_benchmarks(struct arg* d, uint8_t* result, gamma_context* context, size_t pixel_bytes, FILE* info){
+    int first = d->V == VERSION_ALL ? 0 : (int)d->V;
+    int last = d->V == VERSION_ALL ? NUM_VERSIONS - 1 : (int)d->V;
+    size_t count = (size_t)(last - first + 1);
+
+    double* samples = malloc(sizeof(double) * (d->B > 0 ? d->B : 1));
+    struct bench_stats* stats = calloc(count, sizeof(struct bench_stats));
+    if (!samples || !stats) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    struct perf_counters perf;
+    struct perf_counters* counters = NULL;
+    if (d->perf) {
+        if (perf_open(&perf) > 0) {
+            counters = &perf;
+            if (d->T > 1) {
+                fprintf(info, "The hardware counters only cover the calling thread, not the other %u threads. \n", d->T - 1);
+            }
+        } else {
+            fprintf(info, "Hardware counters are not available (see /proc/sys/kernel/perf_event_paranoid), only times are reported. \n");
+        }
+    }
+
+    struct bufpool_stats before, after;
+    bufpool_stats(&before);
+    for (int version = first; version <= last; version++) {
+        if (gamma_set_version(context, version) != GAMMA_OK) {          //the kernel for the current sample size and modes
+            fprintf(stderr,"Invalid version\n");
+            exit(EXIT_FAILURE);
+        }
+        double time = benchmarking(d->B,d->W,context,d->image,d->width,d->height,d->stride,result,d->result_stride,samples,counters);
+        compute_stats(version, samples, d->B, d->width * d->height, pixel_bytes, &stats[version - first]);
+        if (count == 1) {
+            fprintf(info, "The time is: %lf \n",time);      //benchmark tests and running the programm 
+        }
+        if (counters) {
+            print_perf(info, version, counters, (double)d->width * d->height * d->B);     //normalised per processed pixel
+        }
+    }
+    bufpool_stats(&after);
+    print_stats(info, stats, count);
+    fprintf(info, "The runs allocated %zu buffers and caused %ld minor page faults. \n", after.allocations - before.allocations, after.minor_faults - before.minor_faults);
+    if (counters) {
+        perf_close(counters);
+    }
+
+    if (d->json) {
+        write_report(d->json, 0, stats, count, d->width, d->height, d->T);
+    }
+    if (d->csv) {
+        write_report(d->csv, 1, stats, count, d->width, d->height, d->T);
+    }
+    free(samples);
+    free(stats);
+}
+
+// Buffers of the image pool and page faults of the whole run, steady state processing allocates nothing
+static void print_buffer_stats(FILE* info){
+    struct bufpool_stats stats;
+    bufpool_stats(&stats);
+    fprintf(info, "Buffers: %zu allocated (%.1f MB, %zu on huge pages), %zu reused; %ld minor and %ld major page faults. \n",
+            stats.allocations, stats.bytes / 1e6, stats.hugetlb + stats.advised, stats.reuses, stats.minor_faults, stats.major_faults);
+}
+
+// --gamma auto: -B repetitions of the two passes of autoGamma(), the gamma it chooses replaces d->gamma
+static void run_auto_gamma(struct arg* d, const struct point_pipeline* ops, uint8_t* result, thread_pool* pool, FILE* info){
+    struct timespec start, end;
+    int median = 0;
+    uint32_t repetitions = d->B > 0 ? d->B : 1;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t i = 0; i < repetitions; i++) {
+        d->gamma = autoGamma(pool, d->image, d->width, d->height, d->stride, d->c1, d->c2, d->c3, ops, result, d->result_stride, &median);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    fprintf(info, "The time is: %lf \n", (end.tv_sec - start.tv_sec) + 1e-9 * (end.tv_nsec - start.tv_nsec));
+    fprintf(info, "Automatic gamma: the median gray value is %d, gamma %f maps it to mid gray. \n", median, d->gamma);
+}
 
 int main(int argc, char **argv){
     uint8_t* result;
@@ -30,22 +151,242 @@ int main(int argc, char **argv){
         NULL,       
         0,
         0,
+        0,          //stride, set once the image is known
+        0,
+        1,          //default threads
+        NULL,       //input file
+        0,          //no streaming
+        0,          //no parallel pread
+        0,          //no mapped output
+        0,          //no batch mode
+        0,          //no asynchronous I/O
+        0,          //no warmup
+        NULL,       //no JSON report
+        NULL,       //no CSV report
+        0,          //no hardware counters
+        0,          //no accuracy report
+        "0.25,0.5,1,1.8,2.2,3",     //default gamma sweep
+        ACCURACY_HIGH,              //default accuracy of -V auto
+        TUNE_CACHE_FILE,            //default autotuning cache
+        0,          //rows without padding
+        0,          //grayscale output
+        0,          //gamma given with --gamma
+        NULL,       //no daemon
+        NULL,       //no daemon client
+        NULL,       //no point operations
+        NULL,
+        0,
     };
 
     parse(&d, argc, argv);           //getting all the arguments from the user and parsing them
+    if (d.color && (d.S > 0 || d.batch || d.P || d.M || d.compare)) {
+        fprintf(stderr, "Error: --color can't be combined with streaming, --batch, --pread, --mmap-out or --compare.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (d.auto_gamma && (d.S > 0 || d.batch || d.P || d.compare || d.color)) {
+        fprintf(stderr, "Error: --gamma auto can't be combined with streaming, --batch, --pread, --compare or --color.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (d.auto_gamma) {
+        d.V = 2;                         //the two passes of version 2 with the histogram in the first one
+    }
+    if (d.client) {
+        if (d.V == VERSION_ALL || d.V == VERSION_AUTO || d.auto_gamma || d.color) {
+            fprintf(stderr, "Error: --client needs a fixed version and gamma, -Vall, -Vauto, --gamma auto and --color are not supported.\n");
+            exit(EXIT_FAILURE);
+        }
+        FILE* info = strcmp(d.o, "-") == 0 ? stderr : stdout;
+        run_client(d.client, d.input, d.o, d.V, d.c1, d.c2, d.c3, d.gamma, d.B, info);
+        return 0;
+    }
+
+    struct point_pipeline ops;           //--ops, already checked by parse()
+    pipeline_init(&ops);
+    if (d.ops) {
+        pipeline_parse(&ops, d.ops);
+    }
+
+    //the default mode holds the whole image: it is read first, so the context is created for its format
+    PPMImage whole = {0};
+    int whole_image = !d.serve && !d.compare && !d.batch && d.S == 0 && !d.P;
+    if (whole_image) {
+        whole = d.aligned ? read_p6(d.input) : read_p6_mmap(d.input);       //without --aligned the pixels stay in the page cache, no copy
+        if (whole.max_val > 255 && (d.M || d.color || d.auto_gamma || ops.count > 0)) {
+            fprintf(stderr, "Error: 16 bit images can't be used with --mmap-out, --color, --gamma auto or --ops.\n");
+            exit(EXIT_FAILURE);
+        }
+        if (d.color && (d.V == VERSION_ALL || d.V == VERSION_AUTO)) {
+            d.V = 0;                     //one color kernel per instruction set for every version
+        }
+    }
+    int max_val = whole.max_val > 255 ? whole.max_val : 255;     //above 255 the 16 bit variants, the result has the max value of the input
+    int color = whole_image && d.color;                          //the result is RGB
+    struct kernel_plan plan;             //the modes that don't go through the context, its kernel is chosen per mode
+    plan_init(&plan, d.c1, d.c2, d.c3, d.gamma, max_val, color, &ops);
+
+    int exit_status = EXIT_SUCCESS;     //EXIT_FAILURE if a batch skipped files
+    struct gamma_config config = {0, d.c1, d.c2, d.c3, d.gamma, d.T > 1 && !d.batch ? d.T : 1, d.ops, max_val, color};
+    gamma_context* context;
+    int status = gamma_create(&config, &context);             //the version is set per run, see run_benchmarks()
+    if (status != GAMMA_OK) {
+        fprintf(stderr, "Error: %s\n", gamma_strerror(status));
+        exit(EXIT_FAILURE);
+    }
+    gamma_set_padded(context, whole_image && d.aligned && !d.M);      //only then both the image and the result come from image_alloc()
+    thread_pool* pool = gamma_context_pool(context);     //worker threads shared by all iterations and modes
+    FILE* info = strcmp(d.o, "-") == 0 ? stderr : stdout;            //stdout may carry the image
+
+    if (d.serve) {
+        run_server(d.serve, pool, &ops, info);            //until SIGINT or SIGTERM
+        gamma_destroy(context);
+        return 0;
+    }
+    if (d.compare) {
+        float gammas[MAX_GAMMAS];
+        size_t gamma_count = parse_gammas(d.gammas, gammas, MAX_GAMMAS);
+        if (gamma_count == 0) {
+            fprintf(stderr, "Error: Invalid argument for option --gammas. Expected up to %d comma separated non-negative floats.\n", MAX_GAMMAS);
+            exit(EXIT_FAILURE);
+        }
+        char** files;
+        size_t count = collect_batch_inputs(d.inputs, d.inputs_count, &files);
+        run_accuracy(files, count, gammas, gamma_count, d.c1, d.c2, d.c3, &ops, pool, info, d.json);
+        free_batch_inputs(files, count);
+        gamma_destroy(context);
+        print_buffer_stats(info);
+        return 0;
+    } else if (d.batch) {
+        resolve_version(&d, NULL, 1024, 0, &plan, pool, info);         //the sizes of the images are not known in advance
+        plan_version(&plan, d.V);
+        char** files;
+        size_t count = collect_batch_inputs(d.inputs, d.inputs_count, &files);
+        if (check_batch_outputs(files, count) > 0) {
+            fprintf(stderr, "Error: The output names of the batch are not unique, nothing was processed.\n");
+            exit(EXIT_FAILURE);
+        }
+        struct batch_stats stats = run_batch(files, count, d.o, &plan, d.T);     //one image per worker at a time
+        free_batch_inputs(files, count);
+
+        fprintf(info, "The time is: %lf \n", stats.seconds);
+        fprintf(info, "%zu images with %lf megapixels were processed: %lf images/s, %lf megapixels/s \n", stats.images, stats.megapixels,
+                stats.seconds > 0 ? stats.images / stats.seconds : 0.0, stats.seconds > 0 ? stats.megapixels / stats.seconds : 0.0);
+        if (stats.failed > 0) {
+            fprintf(info, "%zu files were skipped because of errors. \n", stats.failed);
+            exit_status = EXIT_FAILURE;
+        }
+    } else if (d.S > 0) {
+        resolve_version(&d, NULL, 1024, 0, &plan, pool, info);         //the pixels are never all in memory
+        plan_version(&plan, d.V);
+        if (d.A && strcmp(d.input, "-") != 0 && strcmp(d.o, "-") != 0) {
+            const char* backend;
+            double time = async_p6_to_p5(d.input, d.o, d.S, &plan, pool, &backend);     //I/O of the neighbouring strips overlaps the processing
+            fprintf(info, "The time is: %lf \n",time);
+            fprintf(info, "The image was streamed in strips of %u rows with %s. \n", d.S, backend);
+        } else {
+            double time = stream_p6_to_p5(d.input, d.o, d.S, &plan, pool);     //read, process and write strip by strip
+            fprintf(info, "The time is: %lf \n",time);
+            fprintf(info, "The image was streamed in strips of %u rows. \n", d.S);
+        }
+    } else if (d.P) {
+        P6Ingest ingest;
+        ingest_open(d.input, &ingest);            //header first, so the result can be allocated before the pixels arrive
+        d.height = ingest.height;
+        d.width = ingest.width;
+        d.stride = d.width * 3;
+        d.result_stride = d.width;
+        resolve_version(&d, NULL, d.width, d.height, &plan, pool, info);      //before the clock starts, the pixels arrive with the processing
+        plan_version(&plan, d.V);
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        P5Output output = d.M ? map_p5(d.o, d.width, d.height) : (P5Output){0};    //the kernels may write straight into the output file
+        result = d.M ? output.pixels : bufpool_get(d.width * d.height);   //allocation for result
+        if (!result) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+
+        struct fused_kernel job = {&plan, d.width, result};
+        PPMImage image_data = ingest_read(&ingest, pool, process_chunk, &job);     //every chunk is processed by the thread that read it
+        d.image = image_data.image;
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        fprintf(info, "The time to result (parallel read and processing) is: %lf \n", (end.tv_sec - start.tv_sec) + 1e-9 * (end.tv_nsec - start.tv_nsec));
+
+        if (d.B > 1) {
+            run_benchmarks(&d, result, context, 3 + 1, info);
+        }
+
+        free_p6(&image_data);
+        if (d.M) {
+            finish_p5(d.o, &output, d.width, d.height);
+        } else {
+            write_p5(d.o,result,d.width,d.height,d.result_stride);
+            bufpool_put(result);
+        }
+    } else {
+        PPMImage image_data = whole;
+        d.image = image_data.image;
+        d.height = image_data.height;
+        d.width = image_data.width;      //Getting the data from the file
+        d.stride = image_data.stride;
+
+        size_t sample_bytes = image_data.max_val > 255 ? 2 : 1;
+        size_t channels = d.color ? 3 : 1;
+
+        P5Output output = d.M ? map_p5(d.o, d.width, d.height) : (P5Output){0};    //the kernels may write straight into the output file
+        if (d.M) {
+            result = output.pixels;
+            d.result_stride = d.width;
+        } else if (d.aligned) {
+            result = image_alloc(d.width, d.height, sample_bytes * channels, &d.result_stride);          //padded rows like the input
+            if (!result) {
+                fprintf(stderr, "Memory allocation failed\n");
+                exit(EXIT_FAILURE);
+            }
+        } else {
+            result = bufpool_get(sample_bytes * channels * d.width * d.height);   //allocation for result
+            d.result_stride = d.width * sample_bytes * channels;
+            if (!result) {
+                fprintf(stderr, "Memory allocation failed\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        if (d.auto_gamma) {
+            run_auto_gamma(&d, &ops, result, pool, info);
+        } else {
+            resolve_version(&d, d.image, d.width, d.height, &plan, pool, info);
+            run_benchmarks(&d, result, context, sample_bytes * (3 + channels), info);
+        }
+
+        free_p6(&image_data);
+        if (d.M) {
+            finish_p5(d.o, &output, d.width, d.height);
+        } else if (d.color) {
+            write_p6(d.o,result,d.width,d.height,d.result_stride);
+            bufpool_put(result);
+        } else if (sample_bytes == 2) {
+            write_p5_16(d.o,result,d.width,d.height,d.result_stride,image_data.max_val);
+            bufpool_put(result);
+        } else {
+            write_p5(d.o,result,d.width,d.height,d.result_stride);       //writing the result and doing the frees needed to avoid memory leaks
+            bufpool_put(result);
+        }
+    }
+    plan_free(&plan);
+    gamma_destroy(context);
+    bufpool_trim();
 
-    result = (uint8_t*)malloc(sizeof(uint8_t) * d.width * d.height);   //allocation for result
-
-    double time = benchmarking(d.B,d.V,d.image,d.width,d.height,d.c1,d.c2,d.c3,d.gamma,result);  
-    printf("The time is: %lf \n",time);      //benchmark tests and running the programm 
-    
-    free(d.image);
-    write_p5(d.o,result,d.width,d.height);       //writing the result and doing the frees needed to avoid memory leaks
-    free(result);
-    printf("The version used is version number %d. \n",d.V);
-    printf("You have done %d iterations. \n", d.B);
-    printf("Your values for a b and c are : a = %f , b = %f, c = %f and the value of your gamma is %f. \n", d.c1, d.c2, d.c3, d.gamma);
-    printf("The output name is %s. \n", d.o);
-    return 0;
+    if (d.V == VERSION_ALL) {
+        fprintf(info, "All versions were used, the output is the one of version %d. \n", NUM_VERSIONS - 1);
+    } else {
+        fprintf(info, "The version used is version number %d. \n",d.V);
+    }
+    fprintf(info, "The instruction set detected is %s, the one used is %s. \n", cpu_isa_name(cpu_detect_isa()), cpu_isa_name(cpu_active_isa()));
+    fprintf(info, "You have done %d iterations with %u threads. \n", d.B, d.T);
+    fprintf(info, "Your values for a b and c are : a = %f , b = %f, c = %f and the value of your gamma is %f. \n", d.c1, d.c2, d.c3, d.gamma);
+    fprintf(info, "The output name is %s. \n", d.o);
+    print_buffer_stats(info);
+    return exit_status;
 }
 
@@ -7,6 +7,13 @@
 #include <time.h>
 #include "read.h"
 #include "parse.h"
+#include "cpu_dispatch.h"
+#include "gamma_V2.h"
+#include "gamma_V4.h"
+#include "pipeline.h"
+#include "autogamma.h"
+#include "stream.h"
+#include "benchmarking.h"
 
 // Helper function to parse floating-point values for options
 void strtof1(char* optarg, char* endptr, const char* option, float* arg, int cases ) {
@@ -69,32 +76,81 @@ static struct option long_options[] = {                       //Long options to
         {"coeffs", required_argument, NULL, 'c'},
         {"gamma", required_argument, NULL, 'g'},
         {"help", no_argument, NULL, 'h'},
+        {"isa", required_argument, NULL, 'I'},
+        {"tile", required_argument, NULL, 't'},
+        {"pread", no_argument, NULL, 'p'},
+        {"mmap-out", no_argument, NULL, 'm'},
+        {"batch", no_argument, NULL, 'b'},
+        {"async", no_argument, NULL, 'a'},
+        {"json", required_argument, NULL, 'j'},
+        {"csv", required_argument, NULL, 'C'},
+        {"perf", no_argument, NULL, 'P'},
+        {"compare", no_argument, NULL, 'A'},
+        {"gammas", required_argument, NULL, 'G'},
+        {"accuracy", required_argument, NULL, 'x'},
+        {"tune-cache", required_argument, NULL, 'k'},
+        {"precision", required_argument, NULL, 'r'},
+        {"aligned", no_argument, NULL, 'l'},
+        {"ops", required_argument, NULL, 'O'},
+        {"color", no_argument, NULL, 'R'},
+        {"serve", required_argument, NULL, 'L'},
+        {"client", required_argument, NULL, 'Q'},
         {0, 0, 0, 0}
     };
 
     char* endptr=NULL;
     int opt = 0;
     
-    while ((opt = getopt_long(argc, argv, "V::B::o:i:h",long_options,NULL)) != -1)
+    while ((opt = getopt_long(argc, argv, "V::B::T::S::W::o:i:h",long_options,NULL)) != -1)
     {
         switch (opt)
         {   // Help information
             case 'h':        
             printf("Help \n");
             printf("Options and their functions: \n");
-            printf("-V<number>: Used to specify the implementation chosen to be executed. <number> should be chosen from 0-4, corresponding to the names of the implementations. If this option is not set, the main implementation is used by default. \n");
+            printf("-V<number>: Used to specify the implementation chosen to be executed. <number> should be chosen from 0-8, corresponding to the names of the implementations. -Vall benchmarks every implementation one after another. -Vauto measures the implementations that meet —accuracy on a sample of the image and uses the fastest, the decision is cached. If this option is not set, the main implementation is used by default. \n");
             printf("-B<number>: If explicitly written, the runtime of the specified implementation will be measured and displayed in the console. <number> specifies the number of function call repetitions. \n");
+            printf("-W<number>: Number of untimed warmup calls before the measured repetitions. Every repetition is timed separately and min, median, mean, p95, p99, standard deviation and throughput are reported. \n");
+            printf("-T<number>: Number of threads. The image is split into bands of rows that are processed in parallel. Without <number> (or with 0) all online CPUs are used. Default is 1. \n");
+            printf("-S<number>: Streaming mode. The image is read, processed and written <number> rows at a time (default 64), so the memory use does not depend on the image size. The input file and the output name - stand for stdin and stdout. \n");
             printf("-o<Dateiname>: Used to specify the output file name. \n");
             printf("—coeffs<FP Zahl>, <FP Zahl>, <FP Zahl>: Used to set the coefficients a, b and c to realise the grayscale conversion.If this option is not set, default values are used. \n");
-            printf("—gamma<Floating Point Zahl>: Used to set the gamma value for gamma correction. This value must be non negative. The most common value is 2.2 according to the latest resolution of modern monitors. If the gamma value is bigger than 1, the output file will appear darker. Otherwise, it will appear lighter. \n");
+            printf("—gamma<Floating Point Zahl>: Used to set the gamma value for gamma correction. This value must be non negative. The most common value is 2.2 according to the latest resolution of modern monitors. If the gamma value is bigger than 1, the output file will appear darker. Otherwise, it will appear lighter. —gamma auto builds a histogram of the gray values while converting to gray and chooses the gamma that maps the median to mid gray (between %.1f and %.1f), then maps the gray image through the gamma table; the input is read only once and -V has no effect. \n", AUTO_GAMMA_MIN, AUTO_GAMMA_MAX);
+            printf("—accuracy<exact|high|medium|low>: Least accurate class -Vauto may choose (compared with version 0, see —compare). Default is high. \n");
+            printf("—tune-cache<Dateiname>: File caching the decisions of -Vauto per CPU, instruction set, image width, accuracy and thread count. Default is %s, - disables the cache. \n", TUNE_CACHE_FILE);
+            printf("—isa<scalar|sse4.1|avx2|avx512>: Limits the instruction set used by versions 3, 4, 6 and 8. By default the widest instruction set supported by the CPU is chosen at startup. \n");
+            printf("—precision<low|medium|high>: Degree of the log2 and exp2 polynomials of versions 4 and 8 (2/2, 4/4 or 6/5). Default is medium. With low these versions only have accuracy medium for —accuracy. \n");
+            printf("—aligned: Copies the input into 64 byte aligned rows with padding and writes the result into such rows as well, so the vectorised versions run whole vectors up to the end of every row instead of a scalar remainder. Helps with widths that are not a multiple of the vector width. Very narrow images are faster without it: there the unpadded rows are processed as one long row. \n");
+            printf("—ops<op>,<op>,...: Point operations applied to the gamma corrected gray values in the given order: gamma=<FP Zahl>, brightness=<FP Zahl> (added), contrast=<FP Zahl> (factor around 128), clamp=<lo>:<hi>, threshold=<FP Zahl> (255 from this value on, 0 below) and invert. Versions 5, 6 and 7 (and —color) fuse gamma correction and all operations into the table they look their result up in, the other versions run one additional table pass over the output of every band. At most %d operations. \n", PIPELINE_MAX_OPS);
+            printf("—color: Color mode. Instead of converting to gray, the gamma correction (and —ops) is applied to every channel with one shared table and the result is written as P6 file <Dateiname>.ppm. The lookups run directly on the interleaved bytes (pshufb with AVX2, vpermi2b with AVX-512 VBMI, scalar lookups otherwise); -V has no effect. \n");
+            printf("—serve<Socket>: Daemon mode. Listens on the Unix domain socket and processes the images of —client requests with the -T threads, which stay warm between the images, until SIGINT or SIGTERM. Options like —ops and —isa given to the server apply to every request. No input file is needed. \n");
+            printf("—client<Socket>: Sends the input file to the daemon listening on the socket and writes the result to -o. The descriptors of the input and output files are passed over the socket (memfds for stdin and stdout), the server reads and writes the pixels through shared mappings without copying. -V, —coeffs and —gamma are sent with the image, -B<number> sends it <number> times and reports the round trip time. \n");
+            printf("—tile<number>: Number of pixels per strip of version 7, which runs the grayscale pass of version 2 and a table pass on one strip at a time. Default is 4096, a value of at least the image size runs both passes over the whole image. \n");
+            printf("—pread: Reads the input in chunks with parallel pread calls on the -T threads. Every chunk is validated and processed by the thread that read it as soon as it arrives. \n");
+            printf("—mmap-out: Creates the output file with its final size and maps it, so the implementation writes the result directly into the file. \n");
+            printf("—batch: Batch mode. Every positional argument is a P6 file, a directory (all .ppm files in it) or @<manifest> (one path per line). The results are written to the directory given with -o, reading, processing (on -T workers) and writing overlap. A file that can't be read or written is reported and skipped and the exit status is 1; inputs with the same name in different directories are rejected before anything is processed, since their results would overwrite each other. \n");
+            printf("—async: Streaming mode with asynchronous I/O (io_uring, or POSIX AIO if io_uring is unavailable). The reads of the next strips and the writes of the previous ones are in flight while a strip is processed. Input and output must be files. \n");
+            printf("—json<Dateiname>, —csv<Dateiname>: Writes the benchmark statistics to the file (- for stdout) as JSON or CSV. \n");
+            printf("—perf: Measures cycles, instructions, IPC, L1d and LLC misses and branch misses of the timed repetitions with perf_event_open and prints them per pixel. Unavailable counters are reported as n/a. \n");
+            printf("—compare: Accuracy report. Every version is run on every input (files, directories or @<manifest> as in batch mode) and compared with version 0: maximum error, PSNR, share of exact pixels, error per gray level and time. With —json the full error histograms are written. \n");
+            printf("—gammas<FP Zahl>,<FP Zahl>,...: Gamma values of the —compare sweep. Default is 0.25,0.5,1,1.8,2.2,3. \n");
             printf("\n");
             printf("Positional arguments: \n");
             printf("-<Dateiname>: Used to specify the input file to be processed. \n");
+            printf("Files with a max value above 255 have 16 bit samples. They are processed by 16 bit variants of versions 0, 4, 5, 6 and 8 (the other versions use the one of version 0) and written as 16 bit P5 with the same max value. Streaming, —batch, —pread, —async, —mmap-out, —compare and —ops only support 8 bit images. \n");
             exit(0);
             break;
             case 'V':
             // Parse and assign the value for the -V option
             char * option="V";
+            if (optarg && strcmp(optarg, "all") == 0) {
+                parser->V = VERSION_ALL;                 // benchmark every version
+                break;
+            }
+            if (optarg && strcmp(optarg, "auto") == 0) {
+                parser->V = VERSION_AUTO;                // resolved by the autotuner once the image is known
+                break;
+            }
             strtol1(optarg,endptr,option,&parser->V);               
             break;
             case 'B':
@@ -102,6 +158,30 @@ static struct option long_options[] = {                       //Long options to
             char * option1="B";
             strtol1(optarg, endptr,option1,&parser->B);
             break;
+            case 'T':
+            // Parse and assign the value for the -T option
+            char * option4="T";
+            parser->T = 0;
+            strtol1(optarg, endptr,option4,&parser->T);
+            if (parser->T == 0) {
+                long cpus = sysconf(_SC_NPROCESSORS_ONLN);      // -T without a number uses every CPU
+                parser->T = cpus > 0 ? (uint32_t)cpus : 1;
+            }
+            break;
+            case 'S':
+            // Parse and assign the value for the -S option
+            char * option6="S";
+            parser->S = STREAM_DEFAULT_ROWS;
+            strtol1(optarg, endptr,option6,&parser->S);
+            if (parser->S == 0) {
+                parser->S = STREAM_DEFAULT_ROWS;
+            }
+            break;
+            case 'W':
+            // Parse and assign the value for the -W option
+            char * option7="W";
+            strtol1(optarg, endptr,option7,&parser->W);
+            break;
             case 'o':
             // Assign the value for the -o option
             parser->o=optarg;
@@ -109,6 +189,10 @@ static struct option long_options[] = {                       //Long options to
             case'g':
             // Parse and assign the value for the --gamma option
             char * option2="gamma";
+            if (optarg && strcmp(optarg, "auto") == 0) {
+                parser->auto_gamma = 1;                 // chosen from the histogram once the image is known
+                break;
+            }
             strtof1(optarg,endptr,option2,&parser->gamma,0);
             break;
             case 'c': 
@@ -118,6 +202,113 @@ static struct option long_options[] = {                       //Long options to
             strtof1(argv[optind++],endptr,option3,&parser->c2,1);
             strtof1(argv[optind++],endptr,option3,&parser->c3,1);
             break;
+            case 'I':
+            // Parse and assign the value for the --isa option
+            enum isa_level isa;
+            if (!cpu_parse_isa(optarg, &isa)) {
+                fprintf(stderr, "Error: Invalid argument for option --isa. Expected scalar, sse4.1, avx2 or avx512.\n");
+                exit(EXIT_FAILURE);
+            }
+            cpu_limit_isa(isa);
+            break;
+            case 't':
+            // Parse and assign the value for the --tile option
+            char * option5="tile";
+            uint32_t tile = 0;
+            strtol1(optarg, endptr,option5,&tile);
+            setTileSize(tile);
+            break;
+            case 'p':
+            // Set the --pread option
+            parser->P = 1;
+            break;
+            case 'm':
+            // Set the --mmap-out option
+            parser->M = 1;
+            break;
+            case 'b':
+            // Set the --batch option
+            parser->batch = 1;
+            break;
+            case 'a':
+            // Set the --async option, it implies streaming
+            parser->A = 1;
+            if (parser->S == 0) {
+                parser->S = STREAM_DEFAULT_ROWS;
+            }
+            break;
+            case 'j':
+            // Assign the value for the --json option
+            parser->json = optarg;
+            break;
+            case 'C':
+            // Assign the value for the --csv option
+            parser->csv = optarg;
+            break;
+            case 'P':
+            // Set the --perf option
+            parser->perf = 1;
+            break;
+            case 'A':
+            // Set the --compare option
+            parser->compare = 1;
+            break;
+            case 'G':
+            // Assign the value for the --gammas option, it is checked by main
+            parser->gammas = optarg;
+            break;
+            case 'x':
+            // Parse and assign the value for the --accuracy option
+            enum accuracy_class accuracy;
+            if (!parse_accuracy(optarg, &accuracy)) {
+                fprintf(stderr, "Error: Invalid argument for option --accuracy. Expected exact, high, medium or low.\n");
+                exit(EXIT_FAILURE);
+            }
+            parser->accuracy = accuracy;
+            break;
+            case 'r':
+            // Parse and assign the value for the --precision option
+            if (strcmp(optarg, "low") == 0) {
+                setPowPrecision(POW_LOW);
+            } else if (strcmp(optarg, "medium") == 0) {
+                setPowPrecision(POW_MEDIUM);
+            } else if (strcmp(optarg, "high") == 0) {
+                setPowPrecision(POW_HIGH);
+            } else {
+                fprintf(stderr, "Error: Invalid argument for option --precision. Expected low, medium or high.\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+            case 'l':
+            // Set the --aligned option
+            parser->aligned = 1;
+            break;
+            case 'O':
+            // Check the --ops option, the operations are used by every version
+            struct point_pipeline ops;
+            pipeline_init(&ops);
+            if (!pipeline_parse(&ops, optarg)) {
+                fprintf(stderr, "Error: Invalid argument for option --ops. Expected up to %d comma separated operations of gamma=<g>, brightness=<d>, contrast=<k>, clamp=<lo>:<hi>, threshold=<t> and invert.\n", PIPELINE_MAX_OPS);
+                exit(EXIT_FAILURE);
+            }
+            parser->ops = optarg;
+            break;
+            case 'R':
+            // Set the --color option
+            parser->color = 1;
+            break;
+            case 'L':
+            // Assign the value for the --serve option
+            parser->serve = optarg;
+            break;
+            case 'Q':
+            // Assign the value for the --client option
+            parser->client = optarg;
+            break;
+            case 'k':
+            // Assign the value for the --tune-cache option
+            parser->tune_cache = strcmp(optarg, "-") == 0 ? NULL : optarg;
+            break;
             default:
             printf("Wrong argument is being pasted.\n");
                 //Unknown argument 
@@ -125,18 +316,17 @@ static struct option long_options[] = {                       //Long options to
                 break;
         }
     }
+    if (optind >= argc && parser->serve) {
+        parser->inputs = argv + optind;          // the daemon gets its images from the clients
+        parser->inputs_count = 0;
+        return;
+    }
     if (optind >= argc) {
          
         fprintf(stderr, "No file given\n");          // Checking for the file
         exit(EXIT_FAILURE);
     }
-    PPMImage image_data = read_p6(argv[optind]);
-            parser->image = image_data.image;
-            parser->height = image_data.height;
-            parser->width = image_data.width;      //Getting the data from the file
-    
-    if (!parser->image) {
-         free(parser->image);
-        exit(EXIT_FAILURE);
-    }
+    parser->input = argv[optind];          //The file is read by main, in streaming mode strip by strip
+    parser->inputs = argv + optind;
+    parser->inputs_count = (size_t)(argc - optind);
 }
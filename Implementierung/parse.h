@@ -16,6 +16,31 @@ struct arg {
     uint8_t* image;
     size_t height;
     size_t width;
+    size_t stride;          // bytes per row of image
+    size_t result_stride;   // bytes per row of the result
+    uint32_t T;
+    char* input;
+    uint32_t S;
+    int P;
+    int M;
+    int batch;
+    int A;
+    uint32_t W;
+    char* json;
+    char* csv;
+    int perf;
+    int compare;
+    char* gammas;
+    int accuracy;        // enum accuracy_class accepted by -V auto
+    char* tune_cache;    // NULL disables the autotuning cache
+    int aligned;         // read into and write from padded, 64 byte aligned rows
+    int color;           // gamma per channel, P6 output
+    int auto_gamma;      // --gamma auto, the gamma is derived from the histogram
+    char* serve;         // socket of the daemon mode, NULL if not serving
+    char* client;        // socket of the daemon to send the image to
+    char* ops;           // --ops, NULL without point operations
+    char** inputs;       // all positional arguments, used by batch mode
+    size_t inputs_count;
 };
 
 void parse(struct arg* parser, int argc, char** argv);
@@ -0,0 +1,105 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "perfcount.h"
+
+/*
+ * Hardware performance counters around the benchmark loop (--perf), read with Linux perf_event_open.
+ *
+ * Every event is opened on its own, so a machine that lacks one of them (e.g. a VM without LLC events) still reports
+ * the others. Only user space of the calling thread is counted: this works with the default perf_event_paranoid
+ * setting, but worker threads of -T are not included.
+ */
+
+static const char* perf_names[PERF_EVENTS] = {
+    [PERF_CYCLES] = "cycles",
+    [PERF_INSTRUCTIONS] = "instructions",
+    [PERF_L1D_MISSES] = "L1d misses",
+    [PERF_LLC_MISSES] = "LLC misses",
+    [PERF_BRANCH_MISSES] = "branch misses",
+};
+
+static int open_event(uint32_t type, uint64_t config){
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+// Opens all counters (disabled), returns the number of events that are available
+int perf_open(struct perf_counters* counters){
+    const uint64_t l1d_read_miss = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+
+    counters->fd[PERF_CYCLES] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    counters->fd[PERF_INSTRUCTIONS] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    counters->fd[PERF_L1D_MISSES] = open_event(PERF_TYPE_HW_CACHE, l1d_read_miss);
+    counters->fd[PERF_LLC_MISSES] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    counters->fd[PERF_BRANCH_MISSES] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+
+    int available = 0;
+    for (int i = 0; i < PERF_EVENTS; i++) {
+        counters->value[i] = 0;
+        available += counters->fd[i] >= 0;
+    }
+    return available;
+}
+
+void perf_close(struct perf_counters* counters){
+    for (int i = 0; i < PERF_EVENTS; i++) {
+        if (counters->fd[i] >= 0) {
+            close(counters->fd[i]);
+            counters->fd[i] = -1;
+        }
+    }
+}
+
+// Resets and enables all available counters
+void perf_start(struct perf_counters* counters){
+    for (int i = 0; i < PERF_EVENTS; i++) {
+        if (counters->fd[i] >= 0) {
+            ioctl(counters->fd[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(counters->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+// Disables the counters and reads their values
+void perf_stop(struct perf_counters* counters){
+    for (int i = 0; i < PERF_EVENTS; i++) {
+        counters->value[i] = 0;
+        if (counters->fd[i] >= 0) {
+            ioctl(counters->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+            if (read(counters->fd[i], &counters->value[i], sizeof(uint64_t)) != sizeof(uint64_t)) {
+                counters->value[i] = 0;
+            }
+        }
+    }
+}
+
+// Prints the counters of one version per processed pixel, "n/a" for unavailable events
+void print_perf(FILE* file, int version, const struct perf_counters* counters, double pixels){
+    fprintf(file, "V%-7d", version);
+    for (int i = 0; i < PERF_EVENTS; i++) {
+        if (counters->fd[i] >= 0 && pixels > 0) {
+            fprintf(file, " %s/pixel %.4f", perf_names[i], counters->value[i] / pixels);
+        } else {
+            fprintf(file, " %s/pixel n/a", perf_names[i]);
+        }
+    }
+    if (counters->fd[PERF_CYCLES] >= 0 && counters->fd[PERF_INSTRUCTIONS] >= 0 && counters->value[PERF_CYCLES] > 0) {
+        fprintf(file, " IPC %.3f", (double)counters->value[PERF_INSTRUCTIONS] / counters->value[PERF_CYCLES]);
+    } else {
+        fprintf(file, " IPC n/a");
+    }
+    fprintf(file, "\n");
+}
@@ -0,0 +1,28 @@
+#ifndef PERFCOUNT_H
+#define PERFCOUNT_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+enum perf_event_id {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_EVENTS,
+};
+
+// One hardware counter per event; fd is -1 for events the kernel or the CPU doesn't offer
+struct perf_counters {
+    int fd[PERF_EVENTS];
+    uint64_t value[PERF_EVENTS];
+};
+
+int perf_open(struct perf_counters* counters);
+void perf_close(struct perf_counters* counters);
+void perf_start(struct perf_counters* counters);
+void perf_stop(struct perf_counters* counters);
+void print_perf(FILE* file, int version, const struct perf_counters* counters, double pixels);
+
+#endif  // PERFCOUNT_H
@@ -0,0 +1,142 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "pipeline.h"
+
+void pipeline_init(struct point_pipeline* pipeline){
+    pipeline->count = 0;
+}
+
+// Appends an operation to the chain, returns 0 if the chain is full
+int pipeline_add(struct point_pipeline* pipeline, enum point_op_type type, float x, float y){
+    if (pipeline->count >= PIPELINE_MAX_OPS) {
+        return 0;
+    }
+    pipeline->ops[pipeline->count++] = (struct point_op){type, x, y};
+    return 1;
+}
+
+static uint8_t saturate(float v){
+    return (uint8_t)fminf(fmaxf(v, 0.0f), 255.0f);
+}
+
+// Result of a single operation for one gray value
+static uint8_t apply_op(const struct point_op* op, uint8_t value){
+    float v = value;
+    switch (op->type) {
+        case OP_GAMMA:
+            return saturate(powf(v / 255.0f, op->x) * 255.0f);
+        case OP_BRIGHTNESS:
+            return saturate(roundf(v + op->x));
+        case OP_CONTRAST:
+            return saturate(roundf((v - 128.0f) * op->x + 128.0f));
+        case OP_CLAMP:
+            return saturate(fminf(fmaxf(v, op->x), op->y));
+        case OP_THRESHOLD:
+            return v >= op->x ? 255 : 0;
+        case OP_INVERT:
+            return (uint8_t)(255 - value);
+    }
+    return value;
+}
+
+/*
+ * Fuses the chain into a lookup table.
+ *
+ * Parameters:
+ *  - const struct point_pipeline* pipeline: The operations, applied in order.
+ *  - uint8_t* table: 256 entries mapping a gray value to the value of the stages before the chain (the identity or a
+ *                    gamma table), every entry is replaced by the result of the whole chain.
+ *
+ * Description:
+ * Every operation maps 8 bit values to 8 bit values, so any chain of them is itself such a mapping and the 256 results
+ * can be computed once per call. The image is then processed with a single lookup per pixel, no matter how many
+ * operations there are: an operation costs 256 evaluations instead of one per pixel. The result is the same as running
+ * the operations one after another on the image.
+ */
+void pipeline_fuse(const struct point_pipeline* pipeline, uint8_t* table){
+    for (size_t i = 0; i < 256; i++) {
+        uint8_t v = table[i];
+        for (size_t k = 0; k < pipeline->count; k++) {
+            v = apply_op(&pipeline->ops[k], v);
+        }
+        table[i] = v;
+    }
+}
+
+// Maps every pixel of an 8 bit image through a 256 entry table in place
+void pipeline_apply(const uint8_t* table, uint8_t* image, size_t width, size_t height, size_t stride){
+    for (size_t y = 0; y < height; y++) {
+        uint8_t* row = image + y * stride;
+        for (size_t x = 0; x < width; x++) {
+            row[x] = table[row[x]];
+        }
+    }
+}
+
+// Parses one number of an --ops argument, returns NULL if there is none
+static const char* parse_number(const char* s, float* value){
+    char* end;
+    *value = strtof(s, &end);
+    return end == s ? NULL : end;
+}
+
+/*
+ * Parses a comma separated list of operations like "brightness=10,contrast=1.2,clamp=16:235,threshold=128,invert"
+ * and appends them to the chain. Returns 0 if the list is malformed, an argument is out of range or the chain is full.
+ */
+int pipeline_parse(struct point_pipeline* pipeline, const char* spec){
+    static const struct {
+        const char* name;
+        enum point_op_type type;
+        int arguments;
+    } names[] = {
+        {"gamma", OP_GAMMA, 1},
+        {"brightness", OP_BRIGHTNESS, 1},
+        {"contrast", OP_CONTRAST, 1},
+        {"clamp", OP_CLAMP, 2},
+        {"threshold", OP_THRESHOLD, 1},
+        {"invert", OP_INVERT, 0},
+    };
+
+    const char* s = spec;
+    while (*s) {
+        size_t length = strcspn(s, "=,");
+        size_t n = 0;
+        while (n < sizeof(names) / sizeof(names[0]) && (strlen(names[n].name) != length || strncmp(s, names[n].name, length) != 0)) {
+            n++;
+        }
+        if (n == sizeof(names) / sizeof(names[0])) {
+            return 0;
+        }
+        s += length;
+
+        float x = 0.0f, y = 0.0f;
+        if (names[n].arguments > 0) {
+            if (*s != '=' || !(s = parse_number(s + 1, &x))) {
+                return 0;
+            }
+            if (names[n].arguments > 1 && (*s != ':' || !(s = parse_number(s + 1, &y)))) {
+                return 0;
+            }
+        }
+        if (*s == ',') {
+            s++;
+        } else if (*s != '\0') {
+            return 0;
+        }
+
+        if ((names[n].type == OP_GAMMA || names[n].type == OP_CONTRAST) && x < 0) {
+            return 0;
+        }
+        if (names[n].type == OP_CLAMP && (x < 0 || y > 255 || x > y)) {
+            return 0;
+        }
+        if (!pipeline_add(pipeline, names[n].type, x, y)) {
+            return 0;
+        }
+    }
+    return 1;
+}
@@ -0,0 +1,37 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+// Longest chain of point operations accepted by --ops
+#define PIPELINE_MAX_OPS 16
+
+// Point operations, every one maps an 8 bit gray value to an 8 bit gray value
+enum point_op_type {
+    OP_GAMMA,         // 255 * (v / 255)^x, truncated like gamma_V0
+    OP_BRIGHTNESS,    // v + x
+    OP_CONTRAST,      // (v - 128) * x + 128
+    OP_CLAMP,         // v limited to [x, y]
+    OP_THRESHOLD,     // 255 if v >= x, 0 otherwise
+    OP_INVERT,        // 255 - v
+};
+
+struct point_op {
+    enum point_op_type type;
+    float x, y;
+};
+
+// Chain of point operations applied in order to the gray values
+struct point_pipeline {
+    struct point_op ops[PIPELINE_MAX_OPS];
+    size_t count;
+};
+
+void pipeline_init(struct point_pipeline* pipeline);
+int pipeline_add(struct point_pipeline* pipeline, enum point_op_type type, float x, float y);
+int pipeline_parse(struct point_pipeline* pipeline, const char* spec);
+void pipeline_fuse(const struct point_pipeline* pipeline, uint8_t* table);
+void pipeline_apply(const uint8_t* table, uint8_t* image, size_t width, size_t height, size_t stride);
+
+#endif  // PIPELINE_H
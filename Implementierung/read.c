@@ -1,135 +1,104 @@
+#define _DEFAULT_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
+#include <errno.h>
 #include "parse.h"
 #include "read.h"
-
-
-
-void skip_spaces(FILE* file) {
-     int c;
-
-    while ((c = fgetc(file)) == ' ' || c == '\t' || c == '\r' || c == '\n') {
-    // Continue reading characters until a non-whitespace character is encountered
-}
-if (c != EOF) {
-     ungetc(c, file);
+#include "image.h"
+
+/*
+ * The reader of the command line tool: the library functions of libgamma.c, which return an error code, plus the
+ * name "-" for stdin and an error message and exit on failure.
+ */
+
+// Prints the error of a library read and exits; max_val is the one of the header for GAMMA_ERROR_RANGE
+static void read_failed(int status, int max_val) {
+    if (status == GAMMA_ERROR_IO) {
+        fprintf(stderr, "Error reading from file: %s\n", strerror(errno));
+    } else if (status == GAMMA_ERROR_RANGE) {
+        fprintf(stderr, "Error: Pixel value exceeds the maximum value of %d\n", max_val);
+    } else {
+        fprintf(stderr, "Error: %s\n", gamma_strerror(status));
+    }
+    exit(EXIT_FAILURE);
 }
+
+// Reads the P6 header up to the first pixel byte: the file is positioned at the start of the pixel data afterwards
+void read_p6_header(FILE* file, size_t* width, size_t* height, int* max_val) {
+    int status = gamma_read_header(file, width, height, max_val);
+    if (status != GAMMA_OK) {
+        read_failed(status, 0);
+    }
 }
 
-void skip_comments(FILE* file) {
-    int ch;
-    do {
-        while ((ch = fgetc(file)) == '#') {
-            // If a comment is found, read until the end of the line
-            while ((ch = fgetc(file)) != '\n' && ch != EOF) {
-                // Continue reading characters until a newline or end of file is encountered
-            }
-        }
-        // Move the file pointer back by one character if it's not the end of file
-        if (ch != EOF) {
-            ungetc(ch, file);
-        }
-    } while (ch == '#');
+// Exits with an error for 16 bit images in the modes that only process 8 bit samples
+void require_8bit(int max_val, const char* mode) {
+    if (max_val > 255) {
+        fprintf(stderr, "Error: 16 bit images (max value %d) are not supported %s.\n", max_val, mode);
+        exit(EXIT_FAILURE);
+    }
 }
 
-//Param 1 : name of the file
+//Param 1 : name of the file, "-" reads from stdin
 // Function to read P6 format PPM image from a file
 PPMImage read_p6(const char* filename) {
-    FILE* file = fopen(filename, "rb");
+    int from_stdin = strcmp(filename, "-") == 0;
+    FILE* file = from_stdin ? stdin : fopen(filename, "rb");
     if (!file) {
         perror("Error opening file");                 //Opening the file we want to read from
         exit(EXIT_FAILURE);
     }
-    skip_comments(file);
-
-    char magic[3];
-    if (fscanf(file, "%2s", magic) == 1) {           //Reading the header of the P6 file
-        
-    } else {
-        fprintf(stderr,"Error reading from file\n");   
-        exit(EXIT_FAILURE);
-    }
-    
-    skip_comments(file);
-    
-
-    if (magic[0] != 'P' || magic[1] != '6') {
-        fprintf(stderr, "Invalid PPM format\n");     //Checking the header if it is right or not
-        exit(EXIT_FAILURE);
-    }
 
     PPMImage ppmImage;
-    skip_spaces(file);
-    skip_comments(file);
-    int temp_width, temp_height;
-    if (fscanf(file, "%d %d", &temp_width, &temp_height) == 2) {         //Reading the width and height 
-        
-    } else {
-        fprintf(stderr,"Error reading from file\n");       
-        exit(EXIT_FAILURE);
+    int status = gamma_read_p6(file, &ppmImage);
+    if (status != GAMMA_OK) {
+        read_failed(status, ppmImage.max_val);
     }
-
-    // Check if width or height is negative
-    if (temp_width <= 0 || temp_height <= 0) {
-        fprintf(stderr, "Error: Width and height cannot be negative or zero.\n");  
-        fclose(file); // Close the file before exiting
-        exit(EXIT_FAILURE);
+    if (!from_stdin) {
+        fclose(file);
     }
-
-    ppmImage.width = (size_t)temp_width;
-    ppmImage.height = (size_t)temp_height;
-
-     skip_spaces(file);
-    skip_comments(file);
-
-     int max_val;                               
-    if (fscanf(file, "%d", &max_val) == 1) { // reading max value
-    // Check if max_val is within the valid range (0 to 255)
-    if (max_val < 0 || max_val > 255) {
-        fprintf(stderr, "Error: Invalid max value. Must be in the range 0 to 255.\n");
-        exit(EXIT_FAILURE);
-    }
-} else {
-    fprintf(stderr,"Error reading or invalid max value\n");
-    exit(EXIT_FAILURE);
+    return ppmImage;
 }
-    
-
-    fgetc(file); // Read newline character
-
-    skip_comments(file);
 
-    ppmImage.image = (uint8_t*)malloc(sizeof(uint8_t) * ppmImage.width * ppmImage.height * 3);    //allocating memory for the pixels of the image
-    if (!ppmImage.image) {
-        fprintf(stderr, "Memory allocation failed\n");
-        exit(EXIT_FAILURE);
+// Maps the file with gamma_read_p6_mmap(), stdin is read with read_p6(); the image must be released with free_p6()
+PPMImage read_p6_mmap(const char* filename) {
+    if (strcmp(filename, "-") == 0) {
+        return read_p6(filename);
     }
-
-
-    size_t elements_read = fread(ppmImage.image, sizeof(uint8_t), ppmImage.width * ppmImage.height * 3, file);    
-
-    if (elements_read == (size_t)(ppmImage.width * ppmImage.height * 3)) {
-        // Read successful
-    } else {
-        fprintf(stderr,"Error reading from file\n");           
+    PPMImage ppmImage;
+    int status = gamma_read_p6_mmap(filename, &ppmImage);
+    if (status == GAMMA_ERROR_IO && !ppmImage.width) {
+        perror("Error opening file");
         exit(EXIT_FAILURE);
     }
-    
-   
-
-    fclose(file);
-
-     for (size_t i = 0; i < ppmImage.width * ppmImage.height * 3; i++) {                
-        if (ppmImage.image[i] > max_val) {
-             // Check if every pixel is smaller or the same as the max value given
-            fprintf(stderr, "Error: Pixel value exceeds the maximum value of 255\n");
-            free(ppmImage.image); // Free allocated memory before exiting
-            exit(EXIT_FAILURE);
-        }
+    if (status != GAMMA_OK) {
+        read_failed(status, ppmImage.max_val);
     }
+    return ppmImage;
+}
 
-    
+// Maps one input of the modes that process many files (--batch, --compare) like read_p6_mmap(), but returns the status
+// instead of exiting: a file that can't be used is reported on stderr and skipped by the caller, the others are still
+// processed. 16 bit images are refused with GAMMA_ERROR_FORMAT, mode names the mode in the message.
+int try_read_p6(const char* filename, PPMImage* image, const char* mode) {
+    int status = gamma_read_p6_mmap(filename, image);
+    if (status == GAMMA_ERROR_IO) {
+        fprintf(stderr, "Skipping %s: %s\n", filename, strerror(errno));
+    } else if (status == GAMMA_ERROR_RANGE) {
+        fprintf(stderr, "Skipping %s: Pixel value exceeds the maximum value of %d\n", filename, image->max_val);
+    } else if (status != GAMMA_OK) {
+        fprintf(stderr, "Skipping %s: %s\n", filename, gamma_strerror(status));
+    } else if (image->max_val > 255) {
+        fprintf(stderr, "Skipping %s: 16 bit images (max value %d) are not supported %s\n", filename, image->max_val, mode);
+        gamma_free_image(image);
+        status = GAMMA_ERROR_FORMAT;
+    }
+    return status;
+}
 
-    return ppmImage;
+// Releases an image returned by read_p6() or read_p6_mmap()
+void free_p6(PPMImage* image) {
+    gamma_free_image(image);
 }
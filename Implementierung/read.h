@@ -6,12 +6,19 @@
 #include <stdint.h>
 #include <unistd.h>
 
-typedef struct {
-    size_t width;
-    size_t height;
-    uint8_t* image;
-} PPMImage;
+#include "libgamma.h"
+#include "image.h"
 
+// The image of the command line tool is the one of the library
+typedef struct gamma_image PPMImage;
+
+#include <stdio.h>
+
+void read_p6_header(FILE* file, size_t* width, size_t* height, int* max_val);
+void require_8bit(int max_val, const char* mode);
 PPMImage read_p6(const char* filename);
+PPMImage read_p6_mmap(const char* filename);
+int try_read_p6(const char* filename, PPMImage* image, const char* mode);
+void free_p6(PPMImage* image);
 
 #endif // PPM_READER_H
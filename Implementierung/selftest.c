@@ -0,0 +1,572 @@
+#define _DEFAULT_SOURCE
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "libgamma.h"
+#include "libgamma_internal.h"
+#include "kernels.h"
+#include "image.h"
+#include "pipeline.h"
+#include "gamma_V4.h"
+#include "gamma_V5.h"
+#include "batch.h"
+
+/*
+ * Self test of the kernels and the library (make check).
+ *
+ * Every version runs on every instruction set the CPU offers, with every --precision, and on widths around the vector
+ * lengths of the kernels,
+ * with three row layouts: packed rows, rows followed by a gap (a region of a larger image: strides wider than the ones
+ * of image_alloc() and no multiple of anything, the bytes of the gap must stay untouched and the input ends right
+ * behind the last pixel) and the padded rows of image_alloc(), run with gamma_set_padded(). The packed output is compared with gamma_V0 within
+ * the bound of the accuracy class of the version, the other layouts must give the same bytes as the packed one. The
+ * 16 bit variants, the color kernels, --ops, the batch mode and the library contexts are checked the same way.
+ *
+ * Every failure is printed on its own line and the exit status is EXIT_FAILURE if there was any; -v additionally
+ * prints the largest error of every version, the numbers the bounds below are taken from.
+ */
+
+static const size_t widths[] = {1, 3, 15, 17, 33, 65};
+static const float gammas[] = {0.45f, 1.0f, 2.2f};
+#define ROWS 5
+#define THREADS 3
+#define GUARD 0xa5
+#define OPS "brightness=10,contrast=1.3,invert"
+
+// Largest difference to gamma_V0 per accuracy class for the gamma values above, in gray levels of 8 bit images; the
+// class of a version may be worse for gamma values close to 0 (see --compare)
+static const int max_error8[] = {
+    [ACCURACY_EXACT] = 0,
+    [ACCURACY_HIGH] = 1,
+    [ACCURACY_MEDIUM] = 4,
+    [ACCURACY_LOW] = 255,
+};
+
+// The same for 16 bit images in levels of the max value. The 16 bit variants never round the gray value to 8 bit, the
+// medium ones (the low tier of --precision, see kernel_accuracy()) are off by a small fraction of the max value.
+static int max_error16(enum accuracy_class accuracy, int max_val){
+    switch (accuracy) {
+        case ACCURACY_EXACT:
+            return 0;
+        case ACCURACY_HIGH:
+            return 4;
+        case ACCURACY_MEDIUM:
+            return 4 + max_val * 15 / 10000;
+        default:
+            return max_val;
+    }
+}
+
+static const char* precision_names[] = {[POW_LOW] = "low", [POW_MEDIUM] = "medium", [POW_HIGH] = "high"};
+
+static int failures = 0;
+static int verbose = 0;
+
+static void fail(const char* format, ...) __attribute__((format(printf, 1, 2)));
+
+static void fail(const char* format, ...){
+    va_list args;
+    va_start(args, format);
+    printf("FAIL: ");
+    vprintf(format, args);
+    printf("\n");
+    va_end(args);
+    failures++;
+}
+
+// Deterministic pseudo random bytes, the same for every run
+static void fill_random(uint8_t* pixels, size_t count, uint32_t seed){
+    for (size_t i = 0; i < count; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        pixels[i] = (uint8_t)(seed >> 24);
+    }
+}
+
+// Creates a context, exits on failure since every later check would fail as well
+static gamma_context* create(int version, float gamma, int max_val, int color, const char* ops){
+    struct gamma_config config = GAMMA_CONFIG_DEFAULT;
+    config.version = version;
+    config.gamma = gamma;
+    config.threads = THREADS;
+    config.max_val = max_val;
+    config.color = color;
+    config.ops = ops;
+    gamma_context* context;
+    int status = gamma_create(&config, &context);
+    if (status != GAMMA_OK) {
+        printf("FAIL: gamma_create(version %d, max value %d, color %d, ops %s): %s\n", version, max_val, color,
+               ops ? ops : "none", gamma_strerror(status));
+        exit(EXIT_FAILURE);
+    }
+    return context;
+}
+
+// An input image in three layouts with the matching results; sample is the number of bytes per sample
+struct layouts {
+    size_t width, sample, channels;
+    uint8_t* packed;                   // rows without gaps
+    uint8_t* gap;                      // the same rows with more than the padding of image_alloc() behind every row
+    uint8_t* padded;                   // the same rows in image_alloc() memory
+    size_t gap_stride, padded_stride;
+    uint8_t* out_packed;
+    uint8_t* out_gap;
+    uint8_t* out_padded;
+    size_t out_gap_stride, out_padded_stride;
+};
+
+#define GAP 14
+
+// Fills the packed rows with random samples up to max_val and copies them into the other layouts
+static void layouts_alloc(struct layouts* l, size_t width, int max_val, size_t channels, uint32_t seed){
+    size_t sample = max_val > 255 ? 2 : 1;
+    l->width = width;
+    l->sample = sample;
+    l->channels = channels;
+    size_t row = width * 3 * sample;
+    size_t out_row = width * sample * channels;
+    l->gap_stride = image_stride(width, 3 * sample) + GAP;
+    l->out_gap_stride = image_stride(width, sample * channels) + GAP;
+    l->packed = malloc(row * ROWS);
+    l->gap = malloc(l->gap_stride * (ROWS - 1) + row);
+    l->padded = image_alloc(width, ROWS, 3 * sample, &l->padded_stride);
+    l->out_packed = malloc(out_row * ROWS);
+    l->out_gap = malloc(l->out_gap_stride * ROWS);
+    l->out_padded = image_alloc(width, ROWS, sample * channels, &l->out_padded_stride);
+    if (!l->packed || !l->gap || !l->padded || !l->out_packed || !l->out_gap || !l->out_padded) {
+        printf("FAIL: Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    fill_random(l->packed, row * ROWS, seed);
+    uint16_t* samples = (uint16_t*)l->packed;
+    for (size_t i = 0; sample == 2 && i < width * 3 * ROWS; i++) {
+        samples[i] = (uint16_t)(samples[i] % (max_val + 1));
+    }
+    memset(l->gap, GUARD, l->gap_stride * (ROWS - 1) + row);
+    for (size_t y = 0; y < ROWS; y++) {
+        memcpy(l->gap + y * l->gap_stride, l->packed + y * row, row);
+        memcpy(l->padded + y * l->padded_stride, l->packed + y * row, row);
+    }
+}
+
+static void layouts_free(struct layouts* l){
+    free(l->packed);
+    free(l->gap);
+    image_free(l->padded);
+    free(l->out_packed);
+    free(l->out_gap);
+    image_free(l->out_padded);
+}
+
+// Runs the context on all three layouts; the packed result is left in out_packed
+static void layouts_run(struct layouts* l, gamma_context* context, const char* what){
+    size_t out_row = l->width * l->sample * l->channels;
+    memset(l->out_gap, GUARD, l->out_gap_stride * ROWS);
+    int status = gamma_process(context, l->packed, l->width, ROWS, l->width * 3 * l->sample, l->out_packed, out_row);
+    if (status == GAMMA_OK) {
+        status = gamma_process(context, l->gap, l->width, ROWS, l->gap_stride, l->out_gap, l->out_gap_stride);
+    }
+    if (status == GAMMA_OK) {
+        gamma_set_padded(context, 1);
+        status = gamma_process(context, l->padded, l->width, ROWS, l->padded_stride, l->out_padded, l->out_padded_stride);
+        gamma_set_padded(context, 0);
+    }
+    if (status != GAMMA_OK) {
+        fail("%s: gamma_process: %s", what, gamma_strerror(status));
+        return;
+    }
+    for (size_t y = 0; y < ROWS; y++) {
+        const uint8_t* packed = l->out_packed + y * out_row;
+        const uint8_t* gap = l->out_gap + y * l->out_gap_stride;
+        if (memcmp(packed, gap, out_row) != 0 || memcmp(packed, l->out_padded + y * l->out_padded_stride, out_row) != 0) {
+            fail("%s: row %zu differs between the packed, gap and padded layouts", what, y);
+            return;
+        }
+        for (size_t i = out_row; i < l->out_gap_stride; i++) {
+            if (gap[i] != GUARD) {
+                fail("%s: the gap behind row %zu was written", what, y);
+                return;
+            }
+        }
+    }
+}
+
+// Largest difference between two results of 8 or 16 bit samples
+static int max_difference(const uint8_t* a, const uint8_t* b, size_t count, size_t sample){
+    int worst = 0;
+    for (size_t i = 0; i < count; i++) {
+        int x = sample == 2 ? ((const uint16_t*)a)[i] : a[i];
+        int y = sample == 2 ? ((const uint16_t*)b)[i] : b[i];
+        int d = x > y ? x - y : y - x;
+        worst = d > worst ? d : worst;
+    }
+    return worst;
+}
+
+/*
+ * Every version on every instruction set against gamma_V0 for 8 bit samples (max_val 255) or 16 bit samples. The
+ * reference runs once per width and gamma, with the widest instruction set, since gamma_V0 is scalar anyway.
+ */
+static void check_versions(int max_val){
+    size_t sample = max_val > 255 ? 2 : 1;
+    enum isa_level detected = cpu_detect_isa();
+    int worst[NUM_VERSIONS] = {0};
+
+    for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) {
+        struct layouts l;
+        layouts_alloc(&l, widths[w], max_val, 1, (uint32_t)(widths[w] * 77 + max_val));
+        size_t count = widths[w] * ROWS;
+        uint8_t* reference = malloc(count * sample);
+        if (!reference) {
+            printf("FAIL: Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+
+        for (size_t g = 0; g < sizeof(gammas) / sizeof(gammas[0]); g++) {
+            cpu_limit_isa(detected);
+            gamma_context* context = create(0, gammas[g], max_val, 0, NULL);
+            gamma_process(context, l.packed, widths[w], ROWS, widths[w] * 3 * sample, reference, widths[w] * sample);
+
+            for (int isa = ISA_SCALAR; isa <= (int)detected; isa++) {
+                cpu_limit_isa((enum isa_level)isa);
+                for (int version = 0; version < NUM_VERSIONS; version++) {
+                    char what[128];
+                    snprintf(what, sizeof(what), "V%d %s %d bit width %zu gamma %g precision %s", version,
+                             cpu_isa_name((enum isa_level)isa), sample == 2 ? 16 : 8, widths[w], gammas[g],
+                             precision_names[getPowPrecision()]);
+                    if (gamma_set_version(context, version) != GAMMA_OK) {
+                        fail("%s: gamma_set_version failed", what);
+                        continue;
+                    }
+                    layouts_run(&l, context, what);
+
+                    const struct kernel_desc* k = find_kernel(version);
+                    enum accuracy_class accuracy = k ? kernel_accuracy(k) : ACCURACY_EXACT;
+                    if (sample == 2 && !(k && k->kernel16)) {
+                        accuracy = ACCURACY_EXACT;                  // these versions run gamma16_V0
+                    }
+                    int error = max_difference(reference, l.out_packed, count, sample);
+                    int bound = sample == 2 ? max_error16(accuracy, max_val) : max_error8[accuracy];
+                    if (error > bound) {
+                        fail("%s: differs from version 0 by %d, the bound of accuracy %s is %d", what, error, accuracy_name(accuracy), bound);
+                    }
+                    worst[version] = error > worst[version] ? error : worst[version];
+                }
+            }
+            gamma_destroy(context);
+        }
+        free(reference);
+        layouts_free(&l);
+    }
+    cpu_limit_isa(detected);
+    for (int version = 0; verbose && version < NUM_VERSIONS; version++) {
+        printf("%d bit, max value %d, precision %s: version %d differs from version 0 by at most %d\n", sample == 2 ? 16 : 8,
+               max_val, precision_names[getPowPrecision()], version, worst[version]);
+    }
+}
+
+// Gray value table of the operations of OPS, the expected mapping of the gray result
+static void ops_table(uint8_t* table){
+    struct point_pipeline ops;
+    pipeline_init(&ops);
+    pipeline_parse(&ops, OPS);
+    for (int v = 0; v < 256; v++) {
+        table[v] = (uint8_t)v;
+    }
+    pipeline_fuse(&ops, table);
+}
+
+/*
+ * --ops: every version with the operations must give its own result without them, mapped through the operations. The
+ * versions with a table have them fused into it, the others run a pass over their output.
+ */
+static void check_ops(void){
+    uint8_t table[256];
+    ops_table(table);
+    enum isa_level detected = cpu_detect_isa();
+    for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) {
+        struct layouts l;
+        layouts_alloc(&l, widths[w], 255, 1, (uint32_t)widths[w] * 13);
+        size_t count = widths[w] * ROWS;
+        uint8_t* plain = malloc(count);
+        if (!plain) {
+            printf("FAIL: Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        for (int isa = ISA_SCALAR; isa <= (int)detected; isa++) {
+            cpu_limit_isa((enum isa_level)isa);
+            for (int version = 0; version < NUM_VERSIONS; version++) {
+                char what[128];
+                snprintf(what, sizeof(what), "V%d %s --ops width %zu", version, cpu_isa_name((enum isa_level)isa), widths[w]);
+                gamma_context* context = create(version, 2.2f, 255, 0, NULL);
+                gamma_process(context, l.packed, widths[w], ROWS, widths[w] * 3, plain, widths[w]);
+                gamma_destroy(context);
+
+                context = create(version, 2.2f, 255, 0, OPS);
+                layouts_run(&l, context, what);
+                gamma_destroy(context);
+                for (size_t i = 0; i < count; i++) {
+                    if (l.out_packed[i] != table[plain[i]]) {
+                        fail("%s: pixel %zu is %d instead of %d", what, i, l.out_packed[i], table[plain[i]]);
+                        break;
+                    }
+                }
+            }
+        }
+        free(plain);
+        layouts_free(&l);
+    }
+    cpu_limit_isa(detected);
+}
+
+// --color: every channel through the gamma table of gamma_V5 with the operations, on every instruction set
+static void check_color(void){
+    uint8_t table[256];
+    uint8_t ops[256];
+    ops_table(ops);
+    buildGammaTable(2.2f, 1, table);
+    enum isa_level detected = cpu_detect_isa();
+    for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) {
+        struct layouts l;
+        layouts_alloc(&l, widths[w], 255, 3, (uint32_t)widths[w] * 31);
+        for (int isa = ISA_SCALAR; isa <= (int)detected; isa++) {
+            cpu_limit_isa((enum isa_level)isa);
+            char what[128];
+            snprintf(what, sizeof(what), "color %s width %zu", cpu_isa_name((enum isa_level)isa), widths[w]);
+            gamma_context* context = create(0, 2.2f, 255, 1, OPS);
+            layouts_run(&l, context, what);
+            gamma_destroy(context);
+            for (size_t i = 0; i < widths[w] * 3 * ROWS; i++) {
+                if (l.out_packed[i] != ops[table[l.packed[i]]]) {
+                    fail("%s: sample %zu is %d instead of %d", what, i, l.out_packed[i], ops[table[l.packed[i]]]);
+                    break;
+                }
+            }
+        }
+        layouts_free(&l);
+    }
+    cpu_limit_isa(detected);
+}
+
+// Arguments of one thread of check_contexts()
+struct context_job {
+    gamma_context* context;
+    const uint8_t* img;
+    size_t width, stride;
+    uint8_t* result;
+    size_t result_stride;
+    int repetitions;
+    int status;
+};
+
+static void* run_context(void* arg){
+    struct context_job* job = arg;
+    for (int i = 0; i < job->repetitions && job->status == GAMMA_OK; i++) {
+        job->status = gamma_process(job->context, job->img, job->width, ROWS, job->stride, job->result, job->result_stride);
+    }
+    return NULL;
+}
+
+/*
+ * The library: contexts with different operations and sample formats used at the same time from two threads must
+ * give the results they give alone, buffers that don't fit the format of a context are rejected, and gamma_set_gamma()
+ * gives the result of a new context with that gamma.
+ */
+static void check_contexts(void){
+    size_t width = 65;
+    struct layouts l8, l16;
+    layouts_alloc(&l8, width, 255, 1, 1);
+    layouts_alloc(&l16, width, 65535, 1, 2);
+    uint8_t* alone8 = malloc(width * ROWS);
+    uint8_t* alone16 = malloc(width * ROWS * 2);
+    uint8_t* together8 = malloc(width * ROWS);
+    uint8_t* together16 = malloc(width * ROWS * 2);
+    if (!alone8 || !alone16 || !together8 || !together16) {
+        printf("FAIL: Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    gamma_context* ops = create(6, 0.45f, 255, 0, OPS);
+    gamma_context* wide = create(5, 2.2f, 65535, 0, NULL);
+    gamma_process(ops, l8.packed, width, ROWS, width * 3, alone8, width);
+    gamma_process(wide, l16.packed, width, ROWS, width * 6, alone16, width * 2);
+
+    struct context_job jobs[2] = {
+        {ops, l8.packed, width, width * 3, together8, width, 200, GAMMA_OK},
+        {wide, l16.packed, width, width * 6, together16, width * 2, 200, GAMMA_OK},
+    };
+    pthread_t threads[2];
+    for (int i = 0; i < 2; i++) {
+        pthread_create(&threads[i], NULL, run_context, &jobs[i]);
+    }
+    for (int i = 0; i < 2; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    if (jobs[0].status != GAMMA_OK || jobs[1].status != GAMMA_OK || memcmp(alone8, together8, width * ROWS) != 0 ||
+        memcmp(alone16, together16, width * ROWS * 2) != 0) {
+        fail("contexts: two contexts used at the same time give other results than alone");
+    }
+
+    if (gamma_process(wide, l16.packed, width, ROWS, width * 3, together16, width * 2) != GAMMA_ERROR_ARGUMENT ||
+        gamma_process(wide, l16.packed, width, ROWS, width * 6, together16, width) != GAMMA_ERROR_ARGUMENT ||
+        gamma_process(wide, l16.packed + 1, width, ROWS, width * 6, together16, width * 2) != GAMMA_ERROR_ARGUMENT) {
+        fail("contexts: a 16 bit context accepted strides or rows of 8 bit samples");
+    }
+    struct gamma_image image = {width, ROWS, width * 3, l8.packed, 255, NULL, 0};
+    if (gamma_process_image(wide, &image, together16, width * 2) != GAMMA_ERROR_FORMAT) {
+        fail("contexts: a 16 bit context accepted an 8 bit image");
+    }
+    image = (struct gamma_image){width, ROWS, width * 6, l16.packed, 4095, NULL, 0};
+    if (gamma_process_image(wide, &image, together16, width * 2) != GAMMA_ERROR_FORMAT) {
+        fail("contexts: a context for max value 65535 accepted an image with max value 4095");
+    }
+    struct gamma_config config = GAMMA_CONFIG_DEFAULT;
+    gamma_context* unused;
+    config.max_val = 65535;
+    config.ops = OPS;
+    if (gamma_create(&config, &unused) != GAMMA_ERROR_ARGUMENT) {
+        fail("contexts: --ops were accepted for 16 bit samples");
+    }
+    config.ops = "brightness";
+    config.max_val = 255;
+    if (gamma_create(&config, &unused) != GAMMA_ERROR_ARGUMENT) {
+        fail("contexts: a malformed ops string was accepted");
+    }
+
+    gamma_context* fresh = create(6, 2.2f, 255, 0, OPS);
+    gamma_set_gamma(ops, 2.2f);
+    gamma_process(ops, l8.packed, width, ROWS, width * 3, alone8, width);
+    gamma_process(fresh, l8.packed, width, ROWS, width * 3, together8, width);
+    if (memcmp(alone8, together8, width * ROWS) != 0) {
+        fail("contexts: gamma_set_gamma() gives another result than a new context");
+    }
+
+    gamma_destroy(ops);
+    gamma_destroy(wide);
+    gamma_destroy(fresh);
+    free(alone8);
+    free(alone16);
+    free(together8);
+    free(together16);
+    layouts_free(&l8);
+    layouts_free(&l16);
+}
+
+// Reads the pixels of a P5 file written by the batch mode, returns NULL if it can't be read
+static uint8_t* read_p5(const char* filename, size_t width, size_t height){
+    FILE* file = fopen(filename, "rb");
+    if (!file) {
+        return NULL;
+    }
+    size_t w, h;
+    int max_val;
+    uint8_t* pixels = malloc(width * height);
+    if (!pixels || fscanf(file, "P5 %zu %zu %d", &w, &h, &max_val) != 3 || fgetc(file) == EOF || w != width ||
+        h != height || fread(pixels, 1, width * height, file) != width * height) {
+        free(pixels);
+        pixels = NULL;
+    }
+    fclose(file);
+    return pixels;
+}
+
+/*
+ * --batch: P6 files written with gamma_write_p6() are converted by run_batch(), every result must be the one of the
+ * plan on the image read back with gamma_read_p6_mmap(); a damaged file is skipped and counted, the others are written.
+ */
+static void check_batch(void){
+    char dir[] = "/tmp/gamma_check_XXXXXX";
+    if (!mkdtemp(dir)) {
+        fail("batch: no temporary directory");
+        return;
+    }
+    char names[4][64];
+    char* files[4];
+    for (size_t i = 0; i < 3; i++) {
+        snprintf(names[i], sizeof(names[i]), "%s/in%zu.ppm", dir, i);
+        files[i] = names[i];
+        struct layouts l;
+        layouts_alloc(&l, widths[i + 2], 255, 1, (uint32_t)i);
+        int fd = open(names[i], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0 || gamma_write_p6(fd, l.packed, widths[i + 2], ROWS, widths[i + 2] * 3) != GAMMA_OK) {
+            fail("batch: writing %s failed", names[i]);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+        layouts_free(&l);
+    }
+    snprintf(names[3], sizeof(names[3]), "%s/broken.ppm", dir);
+    files[3] = names[3];
+    FILE* broken = fopen(names[3], "w");
+    if (broken) {
+        fputs("P6\n10 10\n255\nshort", broken);
+        fclose(broken);
+    }
+
+    struct point_pipeline ops;
+    pipeline_init(&ops);
+    pipeline_parse(&ops, OPS);
+    struct kernel_plan plan;
+    plan_init(&plan, 0.299f, 0.587f, 0.114f, 0.45f, 255, 0, &ops);
+    plan_kernel(&plan, 6);
+    char out[64];
+    snprintf(out, sizeof(out), "%s/out", dir);
+    struct batch_stats stats = run_batch(files, 4, out, &plan, 2);
+    if (stats.images != 3 || stats.failed != 1) {
+        fail("batch: %zu images written and %zu skipped instead of 3 and 1", stats.images, stats.failed);
+    }
+
+    for (size_t i = 0; i < 3; i++) {
+        struct gamma_image image;
+        char result_name[96];
+        snprintf(result_name, sizeof(result_name), "%s/in%zu.pgm", out, i);
+        uint8_t* expected = malloc(widths[i + 2] * ROWS);
+        uint8_t* result = read_p5(result_name, widths[i + 2], ROWS);
+        if (!expected || !result || gamma_read_p6_mmap(names[i], &image) != GAMMA_OK) {
+            fail("batch: %s or its result can't be read", names[i]);
+        } else {
+            plan_run(&plan, image.image, image.width, image.height, image.stride, expected, image.width);
+            if (memcmp(expected, result, image.width * image.height) != 0) {
+                fail("batch: %s differs from the result of the plan", result_name);
+            }
+            gamma_free_image(&image);
+        }
+        free(expected);
+        free(result);
+        unlink(result_name);
+        unlink(names[i]);
+    }
+    plan_free(&plan);
+    unlink(names[3]);
+    rmdir(out);
+    rmdir(dir);
+}
+
+int main(int argc, char** argv){
+    verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+    printf("Checking on %s. \n", cpu_isa_name(cpu_detect_isa()));
+
+    for (int precision = POW_LOW; precision <= POW_HIGH; precision++) {
+        setPowPrecision((enum pow_precision)precision);
+        check_versions(255);
+        check_versions(4095);
+        check_versions(65535);
+    }
+    setPowPrecision(POW_MEDIUM);
+    check_ops();
+    check_color();
+    check_contexts();
+    check_batch();
+
+    if (failures > 0) {
+        printf("%d checks failed. \n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("All checks passed. \n");
+    return EXIT_SUCCESS;
+}
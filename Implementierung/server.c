@@ -0,0 +1,442 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include "read.h"
+#include "write.h"
+#include "kernels.h"
+#include "server.h"
+
+static volatile sig_atomic_t stopping = 0;
+
+static void stop(int signal){
+    (void)signal;
+    stopping = 1;
+}
+
+static double elapsed(const struct timespec* start, const struct timespec* end){
+    return (end->tv_sec - start->tv_sec) + 1e-9 * (end->tv_nsec - start->tv_nsec);
+}
+
+// End of the bytes of rows rows of row_bytes bytes each, returns 0 if it overflows
+static int span(uint64_t offset, uint64_t stride, uint64_t rows, uint64_t row_bytes, uint64_t* end){
+    uint64_t last;
+    return !__builtin_mul_overflow(rows - 1, stride, &last) && !__builtin_add_overflow(last, offset, &last) &&
+           !__builtin_add_overflow(last, row_bytes, end);
+}
+
+// Maps a whole descriptor, its length is stored in size; NULL if it is empty, too large or can't be mapped
+static uint8_t* map_descriptor(int fd, int prot, size_t* size){
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0 || (uint64_t)st.st_size > SIZE_MAX) {
+        return NULL;
+    }
+    *size = (size_t)st.st_size;
+    void* map = mmap(NULL, *size, prot, MAP_SHARED, fd, 0);
+    return map == MAP_FAILED ? NULL : map;
+}
+
+// Coefficients and gamma the kernels are defined for: finite, not negative, and weights that don't add up to zero
+static int valid_parameters(const struct server_request* request){
+    return isfinite(request->a) && isfinite(request->b) && isfinite(request->c) && isfinite(request->gamma) &&
+           request->a >= 0 && request->b >= 0 && request->c >= 0 && request->gamma >= 0 &&
+           request->a + request->b + request->c > 0;
+}
+
+// Makes the plan match the version and parameters of a request, returns 0 if there is no such version. The tables are
+// only rebuilt when the request differs from the previous one, so a client repeating its request doesn't pay for them.
+static int plan_request(struct kernel_plan* plan, uint32_t* version, const struct server_request* request){
+    if (request->version >= NUM_VERSIONS) {
+        return 0;
+    }
+    if (plan->kernel && *version == request->version && plan->a == request->a && plan->b == request->b &&
+        plan->c == request->c && plan->gamma == request->gamma) {
+        return 1;
+    }
+    plan->a = request->a;
+    plan->b = request->b;
+    plan->c = request->c;
+    plan->gamma = request->gamma;
+    if (plan_kernel(plan, (int)request->version) != GAMMA_OK) {
+        plan->kernel = NULL;
+        return 0;
+    }
+    *version = request->version;
+    return 1;
+}
+
+/*
+ * Checks a request, maps its descriptors and runs the kernel from the input into the output mapping.
+ * Returns 0 or an errno value for the reply; nothing a client sends makes the server exit.
+ *
+ * The rows of the request have to end inside the mappings, the kernels touch no byte behind the last pixel of a row:
+ * the plan is never padded (plan_set_padded()), whatever the strides of the client are.
+ */
+static int process_request(const struct server_request* request, int in_fd, int out_fd, thread_pool* pool, struct kernel_plan* plan, uint32_t* version, double* seconds){
+    if (request->magic != SERVER_MAGIC) {
+        return EPROTO;
+    }
+    if (!valid_parameters(request) || !plan_request(plan, version, request) || request->width == 0 || request->height == 0 || request->width > SIZE_MAX / 3 ||
+        request->in_stride < request->width * 3 || request->out_stride < request->width ||
+        request->max_val < 0 || request->max_val > 255) {
+        return EINVAL;
+    }
+    uint64_t in_end, out_end;
+    if (!span(request->in_offset, request->in_stride, request->height, request->width * 3, &in_end) ||
+        !span(request->out_offset, request->out_stride, request->height, request->width, &out_end)) {
+        return EINVAL;
+    }
+
+    size_t in_size, out_size;
+    uint8_t* in = map_descriptor(in_fd, PROT_READ, &in_size);
+    if (!in) {
+        return EINVAL;
+    }
+    uint8_t* out = map_descriptor(out_fd, PROT_READ | PROT_WRITE, &out_size);
+    if (!out) {
+        munmap(in, in_size);
+        return EINVAL;
+    }
+    if (in_end > in_size || out_end > out_size) {
+        munmap(in, in_size);
+        munmap(out, out_size);
+        return EINVAL;
+    }
+
+    int status = 0;
+    const uint8_t* pixels = in + request->in_offset;
+    for (uint64_t y = 0; y < request->height && request->max_val < 255; y++) {
+        if (!check_max_val(pixels + y * request->in_stride, (size_t)request->width * 3, request->max_val)) {
+            status = ERANGE;
+            break;
+        }
+    }
+    if (status == 0) {
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        threadpool_run(pool, plan, pixels, (size_t)request->width, (size_t)request->height, (size_t)request->in_stride,
+                       out + request->out_offset, (size_t)request->out_stride);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        *seconds = elapsed(&start, &end);
+    }
+
+    munmap(in, in_size);
+    munmap(out, out_size);
+    return status;
+}
+
+/*
+ * Receives one request with its descriptors. Returns 1 for a request with exactly two descriptors, -1 for a malformed
+ * one (the descriptors that came with it are closed) and 0 at the end of the connection.
+ */
+static int receive_request(int connection, struct server_request* request, int* fds){
+    union {
+        char buffer[CMSG_SPACE(2 * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct iovec iov = {request, sizeof(*request)};
+    struct msghdr msg = {0};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buffer;
+    msg.msg_controllen = sizeof(control.buffer);
+
+    ssize_t n;
+    do {
+        n = recvmsg(connection, &msg, MSG_CMSG_CLOEXEC);
+    } while (n < 0 && errno == EINTR && !stopping);
+
+    int count = 0;
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            size_t received = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            for (size_t i = 0; i < received; i++) {
+                int fd;
+                memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+                if (count < 2) {
+                    fds[count++] = fd;
+                } else {
+                    close(fd);
+                }
+            }
+        }
+    }
+
+    if (n <= 0 || (size_t)n != sizeof(*request) || count != 2 || (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC))) {
+        for (int i = 0; i < count; i++) {
+            close(fds[i]);
+        }
+        return n <= 0 ? 0 : -1;
+    }
+    return 1;
+}
+
+/*
+ * Daemon mode (--serve): processes the requests of local clients until SIGINT or SIGTERM.
+ *
+ * Parameters:
+ *  - const char* path: Path of the Unix domain socket, an old socket at this path is replaced.
+ *  - thread_pool* pool: The pool of -T, it stays warm across all requests.
+ *  - const struct point_pipeline* ops: The --ops of the server, applied to every request.
+ *  - FILE* info: Stream for the status messages.
+ *
+ * Description:
+ * The socket is a SOCK_SEQPACKET socket, so every request is one message carrying a struct server_request and the
+ * input and output descriptors. A client keeps its connection and may send any number of requests; the connections
+ * are served one after another, and one that stays idle for SERVER_TIMEOUT seconds is closed, so a client that
+ * connects and sends nothing holds up the others for at most that long. The process, the thread pool and the code and data of the kernels stay warm, so a
+ * small image costs two mappings and the kernel instead of a process start, argument parsing and file I/O.
+ */
+void run_server(const char* path, thread_pool* pool, const struct point_pipeline* ops, FILE* info){
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Error: The socket path %s is too long.\n", path);
+        exit(EXIT_FAILURE);
+    }
+    strcpy(address.sun_path, path);
+
+    int listener = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (listener < 0) {
+        perror("Error creating socket");
+        exit(EXIT_FAILURE);
+    }
+    struct stat st;
+    if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(path);                       // left behind by a server that was killed
+    }
+    if (bind(listener, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listener, SERVER_BACKLOG) != 0) {
+        perror("Error binding socket");
+        exit(EXIT_FAILURE);
+    }
+
+    // Without SA_RESTART accept() returns on a signal, so the socket is removed on the way out
+    struct sigaction action = {0};
+    action.sa_handler = stop;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    fprintf(info, "Listening on %s with %u threads. \n", path, threadpool_size(pool));
+    fflush(info);
+
+    struct kernel_plan plan;                // the kernel and tables of the previous request
+    plan_init(&plan, 0, 0, 0, 0, 255, 0, ops);
+    uint32_t version = 0;
+    size_t served = 0;
+    while (!stopping) {
+        int connection = accept4(listener, NULL, NULL, SOCK_CLOEXEC);
+        if (connection < 0) {
+            if (errno != EINTR) {
+                perror("Error accepting connection");
+            }
+            continue;
+        }
+        struct timeval timeout = {SERVER_TIMEOUT, 0};
+        setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(connection, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        for (;;) {
+            struct server_request request = {0};
+            int fds[2];
+            int received = receive_request(connection, &request, fds);
+            if (received == 0) {
+                break;
+            }
+            struct server_reply reply = {EPROTO, request.version, 0.0};
+            if (received > 0) {
+                reply.status = process_request(&request, fds[0], fds[1], pool, &plan, &version, &reply.seconds);
+                close(fds[0]);
+                close(fds[1]);
+            }
+            if (send(connection, &reply, sizeof(reply), MSG_NOSIGNAL) != (ssize_t)sizeof(reply)) {
+                break;
+            }
+            served++;
+        }
+        close(connection);
+    }
+
+    plan_free(&plan);
+    close(listener);
+    unlink(path);
+    fprintf(info, "The server stopped after %zu requests. \n", served);
+}
+
+// Creates a memfd holding a copy of size bytes, for input and output that can't be mapped (stdin, stdout)
+static int memfd_copy(const char* name, const void* data, size_t size){
+    int fd = memfd_create(name, MFD_CLOEXEC);
+    if (fd < 0 || ftruncate(fd, (off_t)size) != 0) {
+        perror("Error creating memfd");
+        exit(EXIT_FAILURE);
+    }
+    size_t done = 0;
+    while (data && done < size) {
+        ssize_t n = pwrite(fd, (const uint8_t*)data + done, size - done, (off_t)done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            perror("Error writing memfd");
+            exit(EXIT_FAILURE);
+        }
+        done += (size_t)n;
+    }
+    return fd;
+}
+
+static int compare_doubles(const void* x, const void* y){
+    double a = *(const double*)x;
+    double b = *(const double*)y;
+    return (a > b) - (a < b);
+}
+
+/*
+ * Client of the daemon (--client): sends one image repetitions times and writes the result.
+ *
+ * Description:
+ * A regular input file is handed to the server as it is (the descriptor and the offset of the pixels behind the
+ * header), the output file is created with its final size and the header, and its descriptor is handed over too, so
+ * the server reads from and writes into the page cache of the two files directly. stdin is read into a memfd and for
+ * stdout the result is written from a memfd afterwards. Round trip and server times are reported.
+ */
+void run_client(const char* path, const char* input, const char* output, uint32_t version, float a, float b, float c, float gamma, uint32_t repetitions, FILE* info){
+    struct server_request request = {SERVER_MAGIC, version, 0, 0, 0, 0, 0, 0, 255, a, b, c, gamma};
+
+    int in_fd = -1;
+    struct stat st;
+    if (strcmp(input, "-") != 0) {
+        FILE* file = fopen(input, "rb");
+        if (!file) {
+            perror("Error opening file");
+            exit(EXIT_FAILURE);
+        }
+        size_t width, height;
+        int max_val;
+        read_p6_header(file, &width, &height, &max_val);
+        if (fstat(fileno(file), &st) == 0 && S_ISREG(st.st_mode)) {
+            request.width = width;
+            request.height = height;
+            request.max_val = max_val;
+            request.in_offset = (uint64_t)ftell(file);
+            request.in_stride = width * 3;
+            in_fd = dup(fileno(file));
+        }
+        fclose(file);
+    }
+    if (in_fd < 0) {
+        PPMImage image = read_p6(input);          // not a regular file: copy the pixels into shared memory once
+        request.width = image.width;
+        request.height = image.height;
+        request.max_val = image.max_val;
+        request.in_stride = image.stride;
+        in_fd = memfd_copy("gamma-input", image.image, image.stride * image.height);
+        free_p6(&image);
+    }
+    require_8bit(request.max_val, "by the server");
+
+    int to_stdout = strcmp(output, "-") == 0;
+    int out_fd;
+    request.out_stride = request.width;
+    if (to_stdout) {
+        out_fd = memfd_copy("gamma-output", NULL, request.width * request.height);
+    } else {
+        char filename[strlen(output) + 5];
+        p5_filename(output, filename);
+        out_fd = open(filename, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        char header[64];
+        int header_length = format_p5_header(header, sizeof(header), request.width, request.height);
+        if (out_fd < 0 || ftruncate(out_fd, header_length + (off_t)(request.width * request.height)) != 0 ||
+            pwrite(out_fd, header, (size_t)header_length, 0) != header_length) {
+            perror("Error opening file");
+            exit(EXIT_FAILURE);
+        }
+        request.out_offset = (uint64_t)header_length;
+    }
+
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Error: The socket path %s is too long.\n", path);
+        exit(EXIT_FAILURE);
+    }
+    strcpy(address.sun_path, path);
+    int connection = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (connection < 0 || connect(connection, (struct sockaddr*)&address, sizeof(address)) != 0) {
+        perror("Error connecting to the server");
+        exit(EXIT_FAILURE);
+    }
+
+    if (repetitions == 0) {
+        repetitions = 1;
+    }
+    double* round_trips = malloc(sizeof(double) * repetitions);
+    if (!round_trips) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    struct server_reply reply = {0};
+    double server_seconds = 0;
+    for (uint32_t r = 0; r < repetitions; r++) {
+        union {
+            char buffer[CMSG_SPACE(2 * sizeof(int))];
+            struct cmsghdr align;
+        } control;
+        memset(&control, 0, sizeof(control));
+        struct iovec iov = {&request, sizeof(request)};
+        struct msghdr msg = {0};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.buffer;
+        msg.msg_controllen = sizeof(control.buffer);
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(2 * sizeof(int));
+        int fds[2] = {in_fd, out_fd};
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (sendmsg(connection, &msg, MSG_NOSIGNAL) != (ssize_t)sizeof(request) ||
+            recv(connection, &reply, sizeof(reply), 0) != (ssize_t)sizeof(reply)) {
+            perror("Error talking to the server");
+            exit(EXIT_FAILURE);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        if (reply.status != 0) {
+            fprintf(stderr, "Error: The server rejected the image: %s\n", strerror(reply.status));
+            exit(EXIT_FAILURE);
+        }
+        round_trips[r] = elapsed(&start, &end);
+        server_seconds += reply.seconds;
+    }
+    close(connection);
+    close(in_fd);
+
+    if (to_stdout) {
+        uint8_t* pixels = mmap(NULL, request.width * request.height, PROT_READ, MAP_SHARED, out_fd, 0);
+        if (pixels == MAP_FAILED) {
+            perror("Error mapping memfd");
+            exit(EXIT_FAILURE);
+        }
+        write_p5("-", pixels, request.width, request.height, request.width);
+        munmap(pixels, request.width * request.height);
+    }
+    close(out_fd);
+
+    qsort(round_trips, repetitions, sizeof(double), compare_doubles);
+    fprintf(info, "The round trip time is: min %lf, median %lf \n", round_trips[0], round_trips[repetitions / 2]);
+    fprintf(info, "The kernel time on the server is: %lf per image \n", server_seconds / repetitions);
+    free(round_trips);
+}
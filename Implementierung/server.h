@@ -0,0 +1,42 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "threadpool.h"
+#include "pipeline.h"
+
+// First field of every request, rejects clients speaking another protocol
+#define SERVER_MAGIC 0x47414d31u          // "GAM1"
+
+// Connections waiting for accept()
+#define SERVER_BACKLOG 16
+// Seconds a connection may stay idle before the server closes it and accepts the next one
+#define SERVER_TIMEOUT 5
+
+/*
+ * Request of the client. Two descriptors travel with it (SCM_RIGHTS): the input and the output. Both may be any file
+ * that can be mapped, a memfd or a regular file; the server maps them, runs the kernel from the input mapping into the
+ * output mapping and unmaps them again, so the pixels are never copied through the socket.
+ */
+struct server_request {
+    uint32_t magic;
+    uint32_t version;              // -V number
+    uint64_t width, height;
+    uint64_t in_offset, in_stride;     // first pixel and bytes per row of the P6 pixels in the input descriptor
+    uint64_t out_offset, out_stride;   // the same for the gray result in the output descriptor
+    int32_t max_val;
+    float a, b, c, gamma;
+};
+
+struct server_reply {
+    int32_t status;                // 0, or an errno value describing why the request was rejected
+    uint32_t version;
+    double seconds;                // time of the kernel on the server
+};
+
+void run_server(const char* path, thread_pool* pool, const struct point_pipeline* ops, FILE* info);
+void run_client(const char* path, const char* input, const char* output, uint32_t version, float a, float b, float c, float gamma, uint32_t repetitions, FILE* info);
+
+#endif  // SERVER_H
@@ -0,0 +1,95 @@
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "read.h"
+#include "write.h"
+#include "stream.h"
+
+/*
+ * Converts a P6 file to a P5 file strip by strip.
+ *
+ * Parameters:
+ *  - const char* input: Name of the P6 file, "-" reads from stdin.
+ *  - const char* output: Output name without extension (".pgm" is appended), "-" writes to stdout.
+ *  - size_t rows: Number of rows per strip.
+ *  - const struct kernel_plan* plan: The kernel to run on every strip with its parameters and tables.
+ *  - thread_pool* pool: Pool that processes each strip in row bands, may be NULL.
+ *
+ * Returns:
+ *  - double: The time in seconds from opening the input until the last strip is written.
+ *
+ * Description:
+ * Only one strip of input (3 * width * rows bytes) and one strip of output (width * rows bytes) are allocated, so the
+ * memory use does not depend on the image height and pipes work without knowing the size in advance. The P5 header is
+ * written right after the P6 header was parsed, and every strip is appended as soon as it is processed.
+ */
+double stream_p6_to_p5(const char* input, const char* output, size_t rows, const struct kernel_plan* plan, thread_pool* pool) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    int from_stdin = strcmp(input, "-") == 0;
+    FILE* in = from_stdin ? stdin : fopen(input, "rb");
+    if (!in) {
+        perror("Error opening file");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t width, height;
+    int max_val;
+    read_p6_header(in, &width, &height, &max_val);
+    require_8bit(max_val, "in streaming mode");
+
+    FILE* out = open_p5(output);
+    if (!out) {
+        perror("Error opening file");
+        exit(EXIT_FAILURE);
+    }
+    write_p5_header(out, width, height);
+
+    if (rows == 0 || rows > height) {
+        rows = height;
+    }
+    uint8_t* strip = malloc(width * rows * 3);
+    uint8_t* result = malloc(width * rows);
+    if (!strip || !result) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t y = 0; y < height; y += rows) {
+        size_t count = height - y < rows ? height - y : rows;
+
+        if (fread(strip, 1, width * count * 3, in) != width * count * 3) {
+            fprintf(stderr, "Error reading from file\n");
+            exit(EXIT_FAILURE);
+        }
+        if (!check_max_val(strip, width * count * 3, max_val)) {
+            fprintf(stderr, "Error: Pixel value exceeds the maximum value of %d\n", max_val);
+            exit(EXIT_FAILURE);
+        }
+
+        threadpool_run(pool, plan, strip, width, count, width * 3, result, width);
+
+        if (fwrite(result, 1, width * count, out) != width * count) {
+            perror("Error writing file");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    free(strip);
+    free(result);
+    if (!from_stdin) {
+        fclose(in);
+    }
+    if (out != stdout) {
+        fclose(out);
+    } else {
+        fflush(out);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start.tv_sec) + 1e-9 * (end.tv_nsec - start.tv_nsec);
+}
@@ -0,0 +1,14 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "kernels.h"
+#include "threadpool.h"
+
+// Rows per strip when -S is given without a number
+#define STREAM_DEFAULT_ROWS 64
+
+double stream_p6_to_p5(const char* input, const char* output, size_t rows, const struct kernel_plan* plan, thread_pool* pool);
+
+#endif  // STREAM_H
@@ -0,0 +1,180 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "threadpool.h"
+#include "kernels.h"
+
+/*
+ * A fixed set of worker threads that execute one parallel loop at a time.
+ *
+ * threadpool_for() publishes a task together with the number of indices, wakes all workers and takes part in the work
+ * itself until every index has been handed out; it returns once all of them are finished. The workers stay alive
+ * between calls, so repeated runs (e.g. the -B repetitions) don't pay for thread creation again.
+ */
+struct thread_pool {
+    pthread_t* workers;
+    unsigned count;               // number of threads including the caller
+    pthread_mutex_t lock;
+    pthread_cond_t work;          // signalled when a new loop is published or the pool shuts down
+    pthread_cond_t done;          // signalled when the last index of a loop is finished
+    pool_task task;
+    void* ctx;
+    size_t tasks;
+    size_t next;                  // next index to hand out
+    size_t finished;
+    unsigned long generation;     // incremented for every published loop
+    int stop;
+};
+
+// Hands out indices of the current loop until none are left; called with the lock held
+static void run_tasks(thread_pool* pool){
+    while(pool->next < pool->tasks){
+        size_t index = pool->next++;
+        pool_task task = pool->task;
+        void* ctx = pool->ctx;
+
+        pthread_mutex_unlock(&pool->lock);
+        task(ctx, index);
+        pthread_mutex_lock(&pool->lock);
+
+        if(++pool->finished == pool->tasks){
+            pthread_cond_broadcast(&pool->done);
+        }
+    }
+}
+
+static void* worker_main(void* arg){
+    thread_pool* pool = arg;
+    unsigned long seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    while(1){
+        while(!pool->stop && pool->generation == seen){
+            pthread_cond_wait(&pool->work, &pool->lock);
+        }
+        if(pool->stop){
+            break;
+        }
+        seen = pool->generation;
+        run_tasks(pool);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+/*
+ * Creates a pool that runs loops on `threads` threads (the calling thread counts as one of them).
+ * Returns NULL if the threads could not be created.
+ */
+thread_pool* threadpool_create(unsigned threads){
+    if(threads == 0){
+        threads = 1;
+    }
+    thread_pool* pool = calloc(1, sizeof(thread_pool));
+    if(!pool){
+        return NULL;
+    }
+    pool->workers = calloc(threads, sizeof(pthread_t));
+    if(!pool->workers){
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    pool->count = 1;
+    for(unsigned i = 0; i + 1 < threads; i++){
+        if(pthread_create(&pool->workers[i], NULL, worker_main, pool) != 0){
+            fprintf(stderr, "Error: Could only start %u of %u threads.\n", pool->count, threads);
+            break;
+        }
+        pool->count++;
+    }
+    return pool;
+}
+
+void threadpool_destroy(thread_pool* pool){
+    if(!pool){
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+
+    for(unsigned i = 0; i + 1 < pool->count; i++){
+        pthread_join(pool->workers[i], NULL);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work);
+    pthread_cond_destroy(&pool->done);
+    free(pool->workers);
+    free(pool);
+}
+
+unsigned threadpool_size(const thread_pool* pool){
+    return pool ? pool->count : 1;
+}
+
+// Calls task(ctx, i) for every i < count in parallel and waits for all of them; without a pool the loop runs inline
+void threadpool_for(thread_pool* pool, pool_task task, void* ctx, size_t count){
+    if(!pool || pool->count == 1 || count <= 1){
+        for(size_t i = 0; i < count; i++){
+            task(ctx, i);
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->task = task;
+    pool->ctx = ctx;
+    pool->tasks = count;
+    pool->next = 0;
+    pool->finished = 0;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work);
+
+    run_tasks(pool);
+    while(pool->finished < pool->tasks){
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// Arguments of one threadpool_run() call shared by all row bands
+struct band_job {
+    const struct kernel_plan* plan;
+    const uint8_t* img;
+    size_t width;
+    size_t height;
+    size_t stride;
+    uint8_t* result;
+    size_t result_stride;
+    size_t bands;
+};
+
+static void run_band(void* ctx, size_t index){
+    struct band_job* job = ctx;
+    size_t first = job->height * index / job->bands;
+    size_t last = job->height * (index + 1) / job->bands;
+
+    plan_run(job->plan, job->img + first * job->stride, job->width, last - first, job->stride,
+             job->result + first * job->result_stride, job->result_stride);
+}
+
+/*
+ * Runs the kernel of a plan on the image split into one band of consecutive rows per thread.
+ *
+ * Every kernel only reads the rows it writes, so a band is processed by calling the unmodified kernel with the band's
+ * first row as image start and the band's row count as height. The tables of the plan are shared by all bands.
+ */
+void threadpool_run(thread_pool* pool, const struct kernel_plan* plan, const uint8_t* img, size_t width, size_t height, size_t stride, uint8_t* result, size_t result_stride){
+    size_t bands = threadpool_size(pool);
+    if(bands > height){
+        bands = height;
+    }
+    struct band_job job = {plan, img, width, height, stride, result, result_stride, bands};
+    threadpool_for(pool, run_band, &job, bands);
+}
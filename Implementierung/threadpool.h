@@ -0,0 +1,19 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+typedef struct thread_pool thread_pool;
+struct kernel_plan;
+
+// Work item of threadpool_for(): called once for every index in [0, count)
+typedef void (*pool_task)(void* ctx, size_t index);
+
+thread_pool* threadpool_create(unsigned threads);
+void threadpool_destroy(thread_pool* pool);
+unsigned threadpool_size(const thread_pool* pool);
+void threadpool_for(thread_pool* pool, pool_task task, void* ctx, size_t count);
+void threadpool_run(thread_pool* pool, const struct kernel_plan* plan, const uint8_t* img, size_t width, size_t height, size_t stride, uint8_t* result, size_t result_stride);
+
+#endif  // THREADPOOL_H
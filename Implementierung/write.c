@@ -1,38 +1,173 @@
+#define _DEFAULT_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include "parse.h"
 #include "read.h"
 #include "write.h"
+#include "libgamma.h"
+#include "image.h"
 #include <string.h>
 
-void write_p5(const char* filename, uint8_t* image, size_t width, size_t height) {
-    // Create a buffer to store the updated filename
-    char updatedFilename[strlen(filename) + 5];  // ".ppm" has 4 characters, plus 1 for null-terminator
-
+// Appends ".pgm" to the output name; the buffer must have strlen(filename) + 5 bytes
+void p5_filename(const char* filename, char* updatedFilename) {
     // Copy the original filename to the buffer
     strcpy(updatedFilename, filename);
 
     // Append ".ppm" to the filename
     strcat(updatedFilename, ".pgm");
+}
 
-    FILE* file = fopen(updatedFilename, "wb");
-    if (!file) {
+// Opens "<filename><extension>" for writing, the name "-" stands for stdout
+static FILE* open_output(const char* filename, const char* extension) {
+    if (strcmp(filename, "-") == 0) {
+        return stdout;
+    }
+
+    // Create a buffer to store the updated filename
+    char updatedFilename[strlen(filename) + strlen(extension) + 1];
+    strcpy(updatedFilename, filename);
+    strcat(updatedFilename, extension);
+
+    return fopen(updatedFilename, "wb");
+}
+
+// Opens "<filename>.pgm" for writing, the name "-" stands for stdout
+FILE* open_p5(const char* filename) {
+    return open_output(filename, ".pgm");
+}
+
+// Formats the P5 header widht and height and max value 255, returns its length
+int format_p5_header(char* header, size_t size, size_t width, size_t height) {
+    return snprintf(header, size, "P5\n%zu %zu\n255\n", width, height);
+}
+
+// Write P5 header widht and height and max value 255
+void write_p5_header(FILE* file, size_t width, size_t height) {
+    fprintf(file, "P5\n%ld %ld\n255\n", width, height);    
+}
+
+// Opens "<filename><extension>" like open_output() for one of the library writers, exits if that fails
+static int open_or_exit(const char* filename, const char* extension, FILE** file) {
+    *file = open_output(filename, extension);
+    if (!*file) {
         perror("Error opening file");
-        free(image);      //Opening the file
         exit(EXIT_FAILURE);
     }
+    fflush(*file);                      // nothing buffered by stdio may end up behind the pixels
+    return fileno(*file);
+}
 
-    // Write P5 header widht and height and max value 255
-    fprintf(file, "P5\n%ld %ld\n255\n", width, height);    
+// Closes the file of open_or_exit(), exits if the library writer failed
+static void close_or_exit(FILE* file, int status) {
+    if (status != GAMMA_OK) {
+        perror("Error writing file");
+        exit(EXIT_FAILURE);
+    }
+    if (file != stdout) {
+        fclose(file);
+    }
+}
 
-    // Write the pixel values in binary mode
-    for (size_t i = 0; i < height; i++) {
-        for (size_t j = 0; j < width; j++) {
-            fwrite(&image[i * width + j], sizeof(uint8_t), 1, file);
+// Writes the image as P5 file "<filename>.pgm" (or to stdout for "-")
+void write_p5(const char* filename, uint8_t* image, size_t width, size_t height, size_t stride) {
+    FILE* file;
+    int fd = open_or_exit(filename, ".pgm", &file);
+    close_or_exit(file, gamma_write_p5(fd, image, width, height, stride));
+}
+
+// Like write_p5(), but reports a failure and returns 0 instead of exiting, so one file can't stop a batch; 1 on success
+int try_write_p5(const char* filename, const uint8_t* image, size_t width, size_t height, size_t stride) {
+    FILE* file = open_output(filename, ".pgm");
+    if (!file) {
+        fprintf(stderr, "Error opening %s.pgm: %s\n", filename, strerror(errno));
+        return 0;
+    }
+    int status = gamma_write_p5(fileno(file), image, width, height, stride);
+    if (status != GAMMA_OK) {
+        fprintf(stderr, "Error writing %s.pgm: %s\n", filename, strerror(errno));
+    }
+    if (fclose(file) != 0 && status == GAMMA_OK) {
+        fprintf(stderr, "Error writing %s.pgm: %s\n", filename, strerror(errno));
+        status = GAMMA_ERROR_IO;
+    }
+    return status == GAMMA_OK;
+}
+
+/*
+ * Writes a 16 bit image (samples in host byte order, stride in bytes) as P5 file with the given max value.
+ *
+ * The samples are swapped to big endian in place, the image can't be used afterwards.
+ */
+void write_p5_16(const char* filename, uint8_t* image, size_t width, size_t height, size_t stride, int max_val) {
+    FILE* file;
+    int fd = open_or_exit(filename, ".pgm", &file);
+    close_or_exit(file, gamma_write_p5_16(fd, image, width, height, stride, max_val));
+}
+
+// Writes an RGB image with max value 255 as P6 file "<filename>.ppm" (or to stdout for "-")
+void write_p6(const char* filename, uint8_t* image, size_t width, size_t height, size_t stride) {
+    FILE* file;
+    int fd = open_or_exit(filename, ".ppm", &file);
+    close_or_exit(file, gamma_write_p6(fd, image, width, height, stride));
+}
+
+/*
+ * Creates "<filename>.pgm" with its final size and maps it, so a kernel can write the pixels straight into the file.
+ *
+ * The header is written into the mapping and output.pixels points right behind it; there is no separate result buffer
+ * and no write call afterwards. stdout can't be mapped, for "-" the pixels are malloced and written by finish_p5().
+ */
+P5Output map_p5(const char* filename, size_t width, size_t height) {
+    P5Output output = {0};
+    if (strcmp(filename, "-") == 0) {
+        output.pixels = malloc(width * height);
+        if (!output.pixels) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
         }
+        return output;
     }
 
+    char updatedFilename[strlen(filename) + 5];
+    p5_filename(filename, updatedFilename);
+    int fd = open(updatedFilename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror("Error opening file");
+        exit(EXIT_FAILURE);
+    }
 
-    fclose(file);
+    char header[64];
+    int header_length = format_p5_header(header, sizeof(header), width, height);
+    output.map_size = (size_t)header_length + width * height;
+    if (ftruncate(fd, (off_t)output.map_size) != 0) {
+        perror("Error writing file");
+        exit(EXIT_FAILURE);
+    }
+    output.map = mmap(NULL, output.map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (output.map == MAP_FAILED) {
+        perror("Error mapping file");
+        exit(EXIT_FAILURE);
+    }
+
+    memcpy(output.map, header, (size_t)header_length);
+    output.pixels = (uint8_t*)output.map + header_length;
+    return output;
+}
+
+// Completes an output created with map_p5(): unmaps the file (the page cache writes it back) or writes the buffer
+void finish_p5(const char* filename, P5Output* output, size_t width, size_t height) {
+    if (output->map) {
+        munmap(output->map, output->map_size);
+    } else {
+        write_p5(filename, output->pixels, width, height, width);
+        free(output->pixels);
+    }
+    output->pixels = NULL;
+    output->map = NULL;
 }
@@ -5,6 +5,22 @@
 #include <stdint.h>
 #include <stdlib.h>
 
-void write_p5(const char* filename, uint8_t* image, size_t width, size_t height);
+// Output image that is either mapped from the .pgm file (map != NULL) or malloced
+typedef struct {
+    uint8_t* pixels;
+    void* map;
+    size_t map_size;
+} P5Output;
+
+void p5_filename(const char* filename, char* updatedFilename);
+int format_p5_header(char* header, size_t size, size_t width, size_t height);
+FILE* open_p5(const char* filename);
+void write_p5_header(FILE* file, size_t width, size_t height);
+void write_p5(const char* filename, uint8_t* image, size_t width, size_t height, size_t stride);
+int try_write_p5(const char* filename, const uint8_t* image, size_t width, size_t height, size_t stride);
+void write_p6(const char* filename, uint8_t* image, size_t width, size_t height, size_t stride);
+void write_p5_16(const char* filename, uint8_t* image, size_t width, size_t height, size_t stride, int max_val);
+P5Output map_p5(const char* filename, size_t width, size_t height);
+void finish_p5(const char* filename, P5Output* output, size_t width, size_t height);
 
 #endif /* WRITE_H */